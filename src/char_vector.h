@@ -0,0 +1,101 @@
+/**
+
+	MultiMarkdown 6 -- Lightweight markup processor to produce HTML, LaTeX, and more.
+
+	@file char_vector.h
+
+	@brief Compare a block of characters at a time, using SSE2 (or AVX2, when
+	compiled with -mavx2).  `kVectorWidth` is only defined when one of these is
+	available, and callers fall back to checking a character at a time.
+
+
+	@author	Fletcher T. Penney
+	@bug	
+
+**/
+
+/*
+
+	Copyright © 2016 - 2017 Fletcher T. Penney.
+
+
+	The `MultiMarkdown 6` project is released under the MIT License..
+	
+	GLibFacade.c and GLibFacade.h are from the MultiMarkdown v4 project:
+	
+		https://github.com/fletcher/MultiMarkdown-4/
+	
+	MMD 4 is released under both the MIT License and GPL.
+	
+	
+	CuTest is released under the zlib/libpng license. See CuTest.c for the text
+	of the license.
+	
+	
+	## The MIT License ##
+	
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+
+*/
+
+
+#ifndef CHAR_VECTOR_MULTIMARKDOWN_H
+#define CHAR_VECTOR_MULTIMARKDOWN_H
+
+#if defined(__AVX2__) || defined(__SSE2__)
+	#include <immintrin.h>
+#endif
+
+
+#if defined(__AVX2__)
+	#define kVector					__m256i
+	#define kVectorWidth			32
+	#define vector_load(p)			_mm256_loadu_si256((const __m256i *) (p))
+	#define vector_set(c)			_mm256_set1_epi8(c)
+	#define vector_eq(a, b)			_mm256_cmpeq_epi8(a, b)
+	#define vector_or(a, b)			_mm256_or_si256(a, b)
+	#define vector_and(a, b)		_mm256_and_si256(a, b)
+	#define vector_andnot(a, b)		_mm256_andnot_si256(a, b)
+	#define vector_sub(a, b)		_mm256_sub_epi8(a, b)
+	#define vector_max(a, b)		_mm256_max_epu8(a, b)
+	#define vector_mask(a)			((unsigned int) _mm256_movemask_epi8(a))
+#elif defined(__SSE2__)
+	#define kVector					__m128i
+	#define kVectorWidth			16
+	#define vector_load(p)			_mm_loadu_si128((const __m128i *) (p))
+	#define vector_set(c)			_mm_set1_epi8(c)
+	#define vector_eq(a, b)			_mm_cmpeq_epi8(a, b)
+	#define vector_or(a, b)			_mm_or_si128(a, b)
+	#define vector_and(a, b)		_mm_and_si128(a, b)
+	#define vector_andnot(a, b)		_mm_andnot_si128(a, b)
+	#define vector_sub(a, b)		_mm_sub_epi8(a, b)
+	#define vector_max(a, b)		_mm_max_epu8(a, b)
+	#define vector_mask(a)			((unsigned int) _mm_movemask_epi8(a))
+#endif
+
+
+#ifdef kVectorWidth
+/// Flag bytes in the (unsigned) range lo...hi
+#define vector_in_range(v, lo, hi)	vector_eq(vector_max(vector_sub(v, vector_set(lo)), vector_set((hi) - (lo))), vector_set((hi) - (lo)))
+
+/// Offset of the first flagged byte in a (non-zero) mask
+#define vector_first(mask)			__builtin_ctz(mask)
+#endif
+
+#endif
@@ -236,6 +236,26 @@ void d_string_append_c_array(DString * baseString, const char * appendedChars, s
 }
 
 
+/// Append integer, in decimal, to end of dynamic string
+void d_string_append_int(DString * baseString, long value)
+{
+	char digits[24];
+	char * start = &digits[sizeof(digits)];
+	unsigned long magnitude = (value < 0) ? 0 - (unsigned long) value : (unsigned long) value;
+
+	// Write digits from the end of the buffer
+	do {
+		*--start = '0' + (magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude);
+
+	if (value < 0)
+		*--start = '-';
+
+	d_string_append_c_array(baseString, start, &digits[sizeof(digits)] - start);
+}
+
+
 /// Append to end of dynamic string using format specifier
 void d_string_append_printf(DString * baseString, const char * format, ...)
 {
@@ -115,6 +115,14 @@ void d_string_append_c_array(
 );
 
 
+/// Append integer, in decimal, to end of dynamic string (without the
+/// allocation and format parsing of `d_string_append_printf()`)
+void d_string_append_int(
+	DString * baseString,					//!< DString to be appended
+	long value								//!< Integer to append
+);
+
+
 /// Append to end of dynamic string using format specifier
 void d_string_append_printf(
 	DString * baseString,					//!< DString to be appended
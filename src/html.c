@@ -65,50 +65,129 @@
 #include "token.h"
 #include "scanners.h"
 #include "writer.h"
+#include "char_vector.h"
 
 
-#define print(x) d_string_append(out, x)
+#define print(x) d_string_append_c_array(out, "" x, sizeof(x) - 1)	// String literals only
+#define print_string(x) d_string_append(out, x)
 #define print_char(x) d_string_append_c(out, x)
+#define print_int(x) d_string_append_int(out, x)
 #define printf(...) d_string_append_printf(out, __VA_ARGS__)
 //#define print_token(t) d_string_append_c_array(out, &(source[t->start + offset]), t->len)
 #define print_token(t) d_string_append_c_array(out, &(source[t->start]), t->len)
 #define print_localized(x) mmd_print_localized_char_html(out, x, scratch)
+#define flush_output() if (scratch->sink) output_sink_check(out, scratch)
 
 // Use Knuth's pseudo random generator to obfuscate email addresses predictably
 long ran_num_next();
 
-void mmd_print_char_html(DString * out, char c, bool obfuscate) {
+/// Print a character that has special meaning in HTML as an entity.  Returns
+/// false for any other character.
+static inline bool mmd_print_entity_html(DString * out, char c) {
 	switch (c) {
 		case '"':
 			print("&quot;");
-			break;
+			return true;
 		case '&':
 			print("&amp;");
-			break;
+			return true;
 		case '<':
 			print("&lt;");
-			break;
+			return true;
 		case '>':
 			print("&gt;");
+			return true;
+	}
+
+	return false;
+}
+
+
+void mmd_print_char_html(DString * out, char c, bool obfuscate) {
+	if (mmd_print_entity_html(out, c))
+		return;
+
+	if (obfuscate && ((int) c == (((int) c) & 127))) {
+		if (ran_num_next() % 2 == 0)
+			printf("&#%d;", (int) c);
+		else
+			printf("&#x%x;", (unsigned int) c);
+	} else {
+		print_char(c);
+	}
+}
+
+
+/// Skip over a run of characters that don't need to be escaped, returning a
+/// pointer to the next one that does (or `stop`).  In text, `"` would be
+/// safe, but it has always been escaped there as well.
+static inline const char * html_skip_clean(const char * c, const char * stop) {
+#ifdef kVectorWidth
+	kVector v, hits;
+	unsigned int mask;
+
+	while (c + kVectorWidth <= stop) {
+		v = vector_load(c);
+
+		hits = vector_or(vector_or(vector_eq(v, vector_set('"')), vector_eq(v, vector_set('&'))),
+			vector_or(vector_eq(v, vector_set('<')), vector_eq(v, vector_set('>'))));
+
+		mask = vector_mask(hits);
+
+		if (mask)
+			return c + vector_first(mask);
+
+		c += kVectorWidth;
+	}
+#endif
+
+	while (c < stop) {
+		switch (*c) {
+			case '"':
+			case '&':
+			case '<':
+			case '>':
+				return c;
+		}
+
+		c++;
+	}
+
+	return c;
+}
+
+
+/// Print `len` characters of text, escaping those with special meaning in
+/// HTML.  Runs that don't need escaping are copied all at once.
+void mmd_print_text_html(DString * out, const char * str, size_t len) {
+	const char * stop = str + len;
+	const char * clean;
+
+	while (str < stop) {
+		clean = html_skip_clean(str, stop);
+
+		if (clean > str)
+			d_string_append_c_array(out, str, clean - str);
+
+		if (clean == stop)
 			break;
-		default:
-			if (obfuscate && ((int) c == (((int) c) & 127))) {
-				if (ran_num_next() % 2 == 0)
-					printf("&#%d;", (int) c);
-				else
-					printf("&#x%x;", (unsigned int) c);
-			} else {
-				print_char(c);
-			}
-			break;
+
+		mmd_print_entity_html(out, *clean);
+		str = clean + 1;
 	}
 }
 
 
+/// Print a string (e.g. an attribute value), escaping characters with special
+/// meaning in HTML.  Obfuscated strings are printed a character at a time.
 void mmd_print_string_html(DString * out, const char * str, bool obfuscate) {
-	while (*str != '\0') {
-		mmd_print_char_html(out, *str, obfuscate);
-		str++;
+	if (obfuscate) {
+		while (*str != '\0') {
+			mmd_print_char_html(out, *str, obfuscate);
+			str++;
+		}
+	} else {
+		mmd_print_text_html(out, str, strlen(str));
 	}
 }
 
@@ -215,9 +294,9 @@ void mmd_export_link_html(DString * out, const char * source, token * text, link
 
 	while (a) {
 		print(" ");
-		print(a->key);
+		print_string(a->key);
 		print("=\"");
-		print(a->value);
+		print_string(a->value);
 		print("\"");
 		a = a->next;
 	}
@@ -233,10 +312,12 @@ void mmd_export_link_html(DString * out, const char * source, token * text, link
 void mmd_export_image_html(DString * out, const char * source, token * text, link * link, size_t offset, scratch_pad * scratch) {
 	attr * a = link->attributes;
 
+	print("<img src=\"");
+
 	if (link->url)
-		printf("<img src=\"%s\"", link->url);
-	else
-		print("<img src=\"\"");
+		print_string(link->url);
+
+	print("\"");
 
 	if (text) {
 		print(" alt=\"");
@@ -247,18 +328,23 @@ void mmd_export_image_html(DString * out, const char * source, token * text, lin
 	if (0 && link->label) {
 		// \todo: Need to decide on approach to id's
 		char * label = label_from_token(source, link->label);
-		printf(" id=\"%s\"", label);
+		print(" id=\"");
+		print_string(label);
+		print("\"");
 		free(label);
 	}
 
-	if (link->title && link->title[0] != '\0')
-		printf(" title=\"%s\"", link->title);
+	if (link->title && link->title[0] != '\0') {
+		print(" title=\"");
+		print_string(link->title);
+		print("\"");
+	}
 
 	while (a) {
 		print(" ");
-		print(a->key);
+		print_string(a->key);
 		print("=\"");
-		print(a->value);
+		print_string(a->value);
 		print("\"");
 		a = a->next;
 	}
@@ -339,14 +425,22 @@ void mmd_export_token_html(DString * out, const char * source, token * t, size_t
 			pad(out, 2, scratch);
 			temp_short = t->type - BLOCK_H1 + 1;
 			if (scratch->extensions & EXT_NO_LABELS) {
-				printf("<h%1d>", temp_short);
+				print("<h");
+				print_int(temp_short);
+				print_char('>');
 			} else {
 				temp_char = label_from_token(source, t);
-				printf("<h%1d id=\"%s\">", temp_short, temp_char);
+				print("<h");
+				print_int(temp_short);
+				print(" id=\"");
+				print_string(temp_char);
+				print("\">");
 				free(temp_char);
 			}
 			mmd_export_token_tree_html(out, source, t->child, t->start + offset, scratch);
-			printf("</h%1d>", temp_short);
+			print("</h");
+			print_int(temp_short);
+			print_char('>');
 			scratch->padded = 0;
 			break;
 		case BLOCK_HR:
@@ -439,7 +533,11 @@ void mmd_export_token_html(DString * out, const char * source, token * t, size_t
 				scratch->footnote_para_counter--;
 
 				if (scratch->footnote_para_counter == 0) {
-					printf(" <a href=\"#fnref:%d\" title=\"%s\" class=\"reversefootnote\">&#160;&#8617;</a>", scratch->footnote_being_printed, LC("return to body"));
+					print(" <a href=\"#fnref:");
+					print_int(scratch->footnote_being_printed);
+					print("\" title=\"");
+					print_string(LC("return to body"));
+					print("\" class=\"reversefootnote\">&#160;&#8617;</a>");
 				}
 			}
 
@@ -447,7 +545,11 @@ void mmd_export_token_html(DString * out, const char * source, token * t, size_t
 				scratch->footnote_para_counter--;
 
 				if (scratch->footnote_para_counter == 0) {
-					printf(" <a href=\"#cnref:%d\" title=\"%s\" class=\"reversecitation\">&#160;&#8617;</a>", scratch->citation_being_printed, LC("return to body"));
+					print(" <a href=\"#cnref:");
+					print_int(scratch->citation_being_printed);
+					print("\" title=\"");
+					print_string(LC("return to body"));
+					print("\" class=\"reversecitation\">&#160;&#8617;</a>");
 				}
 			}
 
@@ -708,16 +810,34 @@ void mmd_export_token_html(DString * out, const char * source, token * t, size_t
 			break;
 		case PAIR_BRACKET_CITATION:
 			if (scratch->extensions & EXT_NOTES) {
+				if (citation_is_deferred(source, scratch, t)) {
+					// Placeholder until the citation is numbered
+					print("<a class=\"citation\">[?]</a>");
+					break;
+				}
+
 				citation_from_bracket(source, scratch, t, &temp_short);
 
 				if (temp_short < scratch->used_citations->size) {
 					// Re-using previous citation
-					printf("<a href=\"#cn:%d\" title=\"%s\" class=\"citation\">[%d]</a>",
-						   temp_short, LC("see citation"), temp_short);
+					print("<a href=\"#cn:");
+					print_int(temp_short);
+					print("\" title=\"");
+					print_string(LC("see citation"));
+					print("\" class=\"citation\">[");
+					print_int(temp_short);
+					print("]</a>");
 				} else {
 					// This is a new citation
-					printf("<a href=\"#cn:%d\" id=\"cnref:%d\" title=\"%s\" class=\"citation\">[%d]</a>",
-						   temp_short, temp_short, LC("see citation"), temp_short);
+					print("<a href=\"#cn:");
+					print_int(temp_short);
+					print("\" id=\"cnref:");
+					print_int(temp_short);
+					print("\" title=\"");
+					print_string(LC("see citation"));
+					print("\" class=\"citation\">[");
+					print_int(temp_short);
+					print("]</a>");
 				}
 			} else {
 				// Footnotes disabled
@@ -726,16 +846,34 @@ void mmd_export_token_html(DString * out, const char * source, token * t, size_t
 			break;
 		case PAIR_BRACKET_FOOTNOTE:
 			if (scratch->extensions & EXT_NOTES) {
+				if (footnote_is_deferred(source, scratch, t)) {
+					// Placeholder until the footnote is numbered
+					print("<a class=\"footnote\">[?]</a>");
+					break;
+				}
+
 				footnote_from_bracket(source, scratch, t, &temp_short);
 
 				if (temp_short < scratch->used_footnotes->size) {
 					// Re-using previous footnote
-					printf("<a href=\"#fn:%d\" title=\"%s\" class=\"footnote\">[%d]</a>",
-						   temp_short, LC("see footnote"), temp_short);
+					print("<a href=\"#fn:");
+					print_int(temp_short);
+					print("\" title=\"");
+					print_string(LC("see footnote"));
+					print("\" class=\"footnote\">[");
+					print_int(temp_short);
+					print("]</a>");
 				} else {
 					// This is a new footnote
-					printf("<a href=\"#fn:%d\" id=\"fnref:%d\" title=\"%s\" class=\"footnote\">[%d]</a>",
-						   temp_short, temp_short, LC("see footnote"), temp_short);
+					print("<a href=\"#fn:");
+					print_int(temp_short);
+					print("\" id=\"fnref:");
+					print_int(temp_short);
+					print("\" title=\"");
+					print_string(LC("see footnote"));
+					print("\" class=\"footnote\">[");
+					print_int(temp_short);
+					print("]</a>");
 				}
 			} else {
 				// Footnotes disabled
@@ -967,6 +1105,9 @@ void mmd_export_token_tree_html(DString * out, const char * source, token * t, s
 			mmd_export_token_html(out, source, t, offset, scratch);
 		}
 
+		// Output for finished tokens can be handed along
+		flush_output();
+
 		t = t->next;
 	}
 }
@@ -1003,6 +1144,9 @@ void mmd_export_token_html_raw(DString * out, const char * source, token * t, si
 			t->next->type = TEXT_EMPTY;
 		case TEXT_EMPTY:
 			break;
+		case TEXT_RAW:
+			mmd_print_text_html(out, &source[t->start], t->len);
+			break;
 		default:
 			if (t->child)
 				mmd_export_token_tree_html_raw(out, source, t->child, offset, scratch);
@@ -1028,7 +1172,7 @@ void mmd_start_complete_html(DString * out, const char * source, scratch_pad * s
 			print("\"/>\n");
 		} else if (strcmp(m->key, "htmlfooter") == 0) {
 		} else if (strcmp(m->key, "htmlheader") == 0) {
-			print(m->value);
+			print_string(m->value);
 			print_char('\n');
 		} else if (strcmp(m->key, "htmlheaderlevel") == 0) {
 		} else if (strcmp(m->key, "lang") == 0) {
@@ -1044,7 +1188,7 @@ void mmd_start_complete_html(DString * out, const char * source, scratch_pad * s
 			print("</title>\n");
 		} else if (strcmp(m->key, "transcludebase") == 0) {
 		} else if (strcmp(m->key, "xhtmlheader") == 0) {
-			print(m->value);
+			print_string(m->value);
 			print_char('\n');
 		} else if (strcmp(m->key, "xhtmlheaderlevel") == 0) {
 		} else {
@@ -1092,7 +1236,9 @@ void mmd_export_footnote_list_html(DString * out, const char * source, scratch_p
 			// Export footnote
 			pad(out, 2, scratch);
 
-			printf("<li id=\"fn:%d\">\n", i + 1);
+			print("<li id=\"fn:");
+			print_int(i + 1);
+			print("\">\n");
 			scratch->padded = 6;
 
 			note = stack_peek_index(scratch->used_footnotes, i);
@@ -1114,7 +1260,7 @@ void mmd_export_footnote_list_html(DString * out, const char * source, scratch_p
 			mmd_export_token_tree_html(out, source, content, 0, scratch);
 
 			pad(out, 1, scratch);
-			printf("</li>");
+			print("</li>");
 			scratch->padded = 0;
 		}
 
@@ -1139,7 +1285,9 @@ void mmd_export_citation_list_html(DString * out, const char * source, scratch_p
 			// Export footnote
 			pad(out, 2, scratch);
 
-			printf("<li id=\"cn:%d\">\n", i + 1);
+			print("<li id=\"cn:");
+			print_int(i + 1);
+			print("\">\n");
 			scratch->padded = 6;
 
 			note = stack_peek_index(scratch->used_citations, i);
@@ -1161,7 +1309,7 @@ void mmd_export_citation_list_html(DString * out, const char * source, scratch_p
 			mmd_export_token_tree_html(out, source, content, 0, scratch);
 
 			pad(out, 1, scratch);
-			printf("</li>");
+			print("</li>");
 			scratch->padded = 0;
 		}
 
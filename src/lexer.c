@@ -57,6 +57,7 @@
 #include "lexer.h"
 #include "libMultiMarkdown.h"
 #include "parser.h"
+#include "char_vector.h"
 
 
 // Basic scanner struct
@@ -67,6 +68,112 @@
 #define YYCTXMARKER	s->ctx
 
 
+/// Can a token start with this character?  Anything else is matched by the
+/// final `.` rule, and simply skipped over.  A single space is not a token,
+/// but two or more are.
+static inline int lexer_char_starts_token(const char * c, const char * stop) {
+	switch (*c) {
+		case ' ':
+			return ((c + 1 < stop) && (c[1] == ' '));
+
+		case '\t':
+		case '\n':
+		case '\r':
+		case '!':
+		case '"':
+		case '#':
+		case '$':
+		case '&':
+		case '\'':
+		case '(':
+		case ')':
+		case '*':
+		case '+':
+		case '-':
+		case '.':
+		case '0':
+		case '1':
+		case '2':
+		case '3':
+		case '4':
+		case '5':
+		case '6':
+		case '7':
+		case '8':
+		case '9':
+		case ':':
+		case '<':
+		case '=':
+		case '>':
+		case '[':
+		case '\\':
+		case ']':
+		case '^':
+		case '_':
+		case '`':
+		case '{':
+		case '|':
+		case '}':
+		case '~':
+			return 1;
+
+		default:
+			return 0;
+	}
+}
+
+
+/// Skip over a run of characters that cannot start a token, returning
+/// a pointer to the next character that might (or `stop`).
+static inline const char * lexer_skip_plain_text(const char * c, const char * stop) {
+#ifdef kVectorWidth
+	// Flag a superset of the token starting characters a block at a time,
+	// and let the scalar check below sort out the candidates.  We need one
+	// extra byte after each block to look for double spaces.
+	kVector v, v_next, hits, space, plain;
+	unsigned int mask;
+
+	space = vector_set(' ');
+
+	while (c + kVectorWidth < stop) {
+		v = vector_load(c);
+		v_next = vector_load(c + 1);
+
+		// Control characters and ASCII punctuation/digits up to '>',
+		// except for common characters that never start a token
+		plain = vector_or(vector_or(vector_eq(v, space), vector_eq(v, vector_set('%'))),
+			vector_or(vector_or(vector_eq(v, vector_set(',')), vector_eq(v, vector_set('/'))), vector_eq(v, vector_set(';'))));
+		hits = vector_andnot(plain, vector_in_range(v, 0x00, '>'));
+
+		// `[\]^_` and backtick; `{|}~`
+		hits = vector_or(hits, vector_in_range(v, '[', '`'));
+		hits = vector_or(hits, vector_in_range(v, '{', '~'));
+
+		// Two or more spaces
+		hits = vector_or(hits, vector_and(vector_eq(v, space), vector_eq(v_next, space)));
+
+		mask = vector_mask(hits);
+
+		while (mask) {
+			const char * candidate = c + vector_first(mask);
+
+			if (lexer_char_starts_token(candidate, stop))
+				return candidate;
+
+			mask &= mask - 1;
+		}
+
+		c += kVectorWidth;
+	}
+#endif
+
+	while (c < stop && !lexer_char_starts_token(c, stop))
+		c++;
+
+	return c;
+}
+
+
 int scan(Scanner * s, const char * stop) {
 
 	scan:
@@ -75,6 +182,16 @@ int scan(Scanner * s, const char * stop) {
 		return 0;
 	}
 
+	// Jump over plain text that can only match the final `.` rule
+	s->cur = lexer_skip_plain_text(s->cur, stop);
+
+	if (s->cur >= stop) {
+		// Text was skipped up to `stop`, which must still be reported as
+		// characters between tokens
+		s->start = s->cur;
+		return 0;
+	}
+
 	s->start = s->cur;
 
 	
@@ -57,6 +57,7 @@
 #define MMD6_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 
@@ -83,6 +84,18 @@ mmd_engine * mmd_engine_create_with_string(
 );
 
 
+/// Create MMD Engine that parses a caller-owned buffer in place, such as a
+/// memory-mapped file (A copy is *not* made.  `str[len]` must be readable and
+/// NUL, as it is at the end of a mapped file whose size is not a multiple of
+/// the page size.  The buffer must remain valid and unchanged until the
+/// engine is freed, and is not freed with the engine.)
+mmd_engine * mmd_engine_create_with_buffer(
+	const char *	str,
+	size_t			len,
+	unsigned long	extensions
+);
+
+
 /// Free an existing MMD Engine
 void mmd_engine_free(
 	mmd_engine * e,
@@ -90,6 +103,44 @@ void mmd_engine_free(
 );
 
 
+/// Reset an existing MMD Engine to parse new source text, keeping its
+/// configuration (extensions, language) and the memory it has already
+/// allocated.  The parse tree, and everything found by the last parse (links,
+/// footnotes, metadata, etc.), are freed.  Engines created with
+/// `mmd_engine_create_with_buffer()` parse `str` in place, and it must remain
+/// valid until the engine is reset again or freed.  Otherwise, `str` is copied
+/// into the engine's string, replacing what was there.
+void mmd_engine_reset(
+	mmd_engine *	e,
+	const char *	str,
+	size_t			len
+);
+
+
+/// Change the extensions used by an MMD Engine.  This takes effect on the
+/// next parse.
+void mmd_engine_set_extensions(
+	mmd_engine *	e,
+	unsigned long	extensions
+);
+
+
+#ifdef kUseObjectPool
+/// Token arena owned by the engine.  Every token in the engine's parse tree
+/// is allocated from this arena, and remains valid until the engine is freed.
+/// Engines do not share arenas, so separate engines can be kept alive at the
+/// same time, and can parse on separate threads.  Use `token_pool_use()`
+/// with this arena before adding new tokens to the engine's tree.
+struct pool * mmd_engine_token_pool(mmd_engine * e);
+#endif
+
+
+/// Number of lemon parsers the engine has created.  Parsers are kept and
+/// reused, so this is the deepest block nesting (lists, blockquotes) parsed
+/// so far, not the number of blocks.
+size_t mmd_engine_parser_count(mmd_engine * e);
+
+
 /// Parse part of the string into a token tree
 token * mmd_engine_parse_substring(mmd_engine * e, size_t byte_start, size_t byte_len);
 
@@ -98,9 +149,110 @@ token * mmd_engine_parse_substring(mmd_engine * e, size_t byte_start, size_t byt
 void mmd_engine_parse_string(mmd_engine * e);
 
 
+/// Parse the next top level segment of the string, starting at `*offset`,
+/// into a token tree, and move `*offset` past it.  Segments end at blank
+/// lines that no block continues past, so each one parses the same way it
+/// would as part of the entire string.  Returns NULL at the end of the string.
+token * mmd_engine_parse_segment(mmd_engine * e, size_t * offset);
+
+
+/// Like `mmd_engine_parse_segment()`, but the segment is only parsed if it
+/// has lines that might hold definitions, headers, or metadata (or blocks
+/// that contain other blocks).  Otherwise its lines are only tokenized, which
+/// is much quicker.  This is enough to find everything a reference might
+/// point to before exporting.
+token * mmd_engine_scan_segment(mmd_engine * e, size_t * offset);
+
+
+/// Callback used to read source text for `mmd_engine_parse_stream()`.  Copy
+/// up to `buffer_size` bytes into `buffer`, and return the number of bytes
+/// copied.  Return 0 at the end of input.
+typedef size_t (*mmd_read_callback)(void * context, char * buffer, size_t buffer_size);
+
+
+/// Read source text through a callback, appending it to the engine's string,
+/// and parse the entire string into a token tree.  Lines are tokenized as
+/// they arrive, so this can overlap with slow input (e.g. a pipe).
+/// Not for engines created with `mmd_engine_create_with_buffer()`.
+void mmd_engine_parse_stream(mmd_engine * e, mmd_read_callback read, void * context);
+
+
 void mmd_export_token_tree(DString * out, mmd_engine * e, short format);
 
 
+/// Callback used to write output for `mmd_export_token_tree_to_sink()`.
+/// `buffer` holds the next `len` bytes of output, and is only valid until
+/// the callback returns.
+typedef void (*mmd_write_callback)(void * context, const char * buffer, size_t len);
+
+
+/// Export the token tree, handing the output to a callback in pieces as it
+/// is rendered, rather than building all of it in memory.  Output is passed
+/// along whenever at least `flush_threshold` bytes are waiting (0 to pass it
+/// along after each token), and once more when the export is complete.
+void mmd_export_token_tree_to_sink(
+	mmd_engine *		e,
+	short				format,
+	mmd_write_callback	write,
+	void *				context,
+	size_t				flush_threshold
+);
+
+
+/// Export the token tree to a stdio stream as it is rendered (see
+/// `mmd_export_token_tree_to_sink()`)
+void mmd_export_token_tree_to_file(
+	mmd_engine *		e,
+	short				format,
+	FILE *				stream,
+	size_t				flush_threshold
+);
+
+
+/// Parse and export the string a top level segment at a time, handing the
+/// output for each segment to `progress` (if not NULL) as soon as it is ready,
+/// so that a preview can be shown before the rest of the string is parsed.
+/// References to links, footnotes or citations that are defined later in the
+/// string are shown as placeholders in that output.  Blocks with placeholders
+/// are rendered again once the whole string has been parsed, and `out` holds
+/// the finished document (the same as `mmd_export_token_tree()`).  The parse
+/// tree is kept, as if from `mmd_engine_parse_string()`.
+void mmd_export_progressive(
+	DString *			out,
+	mmd_engine *		e,
+	short				format,
+	mmd_write_callback	progress,
+	void *				context
+);
+
+
+/// Parse and export the string in two passes, so that only one top level
+/// segment is in memory at a time, rather than the whole parse tree.  The
+/// first pass finds the definitions, headers and metadata.  The second parses
+/// each segment, hands its output to `write` (see
+/// `mmd_export_token_tree_to_sink()`), and frees it.  The output is identical
+/// to `mmd_export_token_tree()`, byte for byte, since segments are rendered
+/// once and in order (obfuscated email addresses included), but no parse tree
+/// is kept.
+void mmd_export_segments_to_sink(
+	mmd_engine *		e,
+	short				format,
+	mmd_write_callback	write,
+	void *				context,
+	size_t				flush_threshold
+);
+
+
+/// Parse and export the string a segment at a time to a stdio stream (see
+/// `mmd_export_segments_to_sink()`)
+void mmd_export_segments_to_file(
+	mmd_engine *		e,
+	short				format,
+	FILE *				stream,
+	size_t				flush_threshold
+);
+
+
 /// Set language and smart quotes language
 void mmd_engine_set_language(mmd_engine * e, short language);
 
@@ -256,6 +408,7 @@ enum token_types {
 	TEXT_NUMBER_POSS_LIST,
 	TEXT_PERIOD,
 	TEXT_PLAIN,
+	TEXT_RAW,						//!< Contents of a line in a fenced code block
 };
 
 
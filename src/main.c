@@ -59,41 +59,40 @@
 #include <string.h>
 
 
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <pthread.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
 #include "argtable3.h"
 #include "d_string.h"
 #include "i18n.h"
 #include "libMultiMarkdown.h"
-#include "html.h"
 #include "mmd.h"
 #include "token.h"
 #include "version.h"
 
 #define kBUFFERSIZE 4096	// How many bytes to read at a time
 
+#define kOutputFlushThreshold (64 * 1024)	// How much output to collect before writing it
+
+#define kThreadStackSize (8 * 1024 * 1024)	// Deeply nested documents need the same stack as the main thread
+
 // argtable structs
-struct arg_lit *a_help, *a_version, *a_compatibility, *a_nolabels, *a_batch, *a_accept, *a_reject, *a_full, *a_snippet;
+struct arg_lit *a_help, *a_version, *a_compatibility, *a_nolabels, *a_batch, *a_accept, *a_reject, *a_full, *a_snippet, *a_low_memory;
 struct arg_str *a_format, *a_lang;
+struct arg_int *a_jobs, *a_depth;
 struct arg_file *a_file, *a_o;
 struct arg_end *a_end;
 struct arg_rem *a_rem1, *a_rem2, *a_rem3, *a_rem4;
 
 
-DString * stdin_buffer() {
-	/* Read from stdin and return a GString *
-		`buffer` will need to be freed elsewhere */
-
-	char chunk[kBUFFERSIZE];
-	size_t bytes;
-
-	DString * buffer = d_string_new("");
-
-	while ((bytes = fread(chunk, 1, kBUFFERSIZE, stdin)) > 0) {
-		d_string_append_c_array(buffer, chunk, bytes);
-	}
-
-	fclose(stdin);
-
-	return buffer;
+/// Read callback used to stream source text from a file (e.g. stdin)
+size_t stream_read(void * context, char * buffer, size_t buffer_size) {
+	return fread(buffer, 1, buffer_size, (FILE *) context);
 }
 
 
@@ -122,6 +121,106 @@ DString * scan_file(const char * fname) {
 }
 
 
+#ifndef _WIN32
+/// Size of the mapping used for a file of `len` bytes -- there is always at
+/// least one extra zero byte, even if `len` is a multiple of the page size
+static size_t map_size(size_t len) {
+	size_t page = (size_t) sysconf(_SC_PAGESIZE);
+
+	return (len / page + 1) * page;
+}
+
+
+/// Map a file into memory (read-only) instead of copying it.  The contents
+/// are followed by a NUL byte.  Returns NULL if the file can't be mapped
+/// (e.g. it is empty, or isn't a regular file).
+char * map_file(const char * fname, size_t * len) {
+	struct stat info;
+	char * map = NULL;
+
+	int fd = open(fname, O_RDONLY);
+
+	if (fd < 0)
+		return NULL;
+
+	if ((fstat(fd, &info) == 0) && S_ISREG(info.st_mode) && (info.st_size > 0)) {
+		*len = (size_t) info.st_size;
+
+		// Reserve zeroed memory for the whole mapping, then map the file over
+		// the start of it, so that reading one past the end is safe
+		map = mmap(NULL, map_size(*len), PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (map == MAP_FAILED) {
+			map = NULL;
+		} else if (mmap(map, *len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+			munmap(map, map_size(*len));
+			map = NULL;
+		}
+	}
+
+	close(fd);
+
+	return map;
+}
+
+
+/// Release a file mapped with `map_file()`
+void unmap_file(char * map, size_t len) {
+	munmap(map, map_size(len));
+}
+
+
+/// Do both names refer to the same (existing) file?
+bool same_file(const char * a, const char * b) {
+	struct stat info_a;
+	struct stat info_b;
+
+	if ((stat(a, &info_a) != 0) || (stat(b, &info_b) != 0))
+		return false;
+
+	return (info_a.st_dev == info_b.st_dev) && (info_a.st_ino == info_b.st_ino);
+}
+#endif
+
+
+/// Read the named file, mapping it into memory where possible rather than
+/// copying it.  Whichever of `map` or `buffer` is used has to be released
+/// once the text is no longer needed.
+const char * source_for_file(const char * fname, size_t * len, char ** map, size_t * map_len, DString ** buffer) {
+	*map = NULL;
+	*buffer = NULL;
+
+#ifndef _WIN32
+	*map = map_file(fname, map_len);
+
+	if (*map) {
+		*len = *map_len;
+		return *map;
+	}
+#endif
+
+	*buffer = scan_file(fname);
+
+	if (*buffer == NULL)
+		return NULL;
+
+	*len = (*buffer)->currentStringLength;
+	return (*buffer)->str;
+}
+
+
+/// Release the source text used by `source_for_file()`
+void release_file(char * map, size_t map_len, DString * buffer) {
+#ifndef _WIN32
+	if (map)
+		unmap_file(map, map_len);
+#endif
+
+	if (buffer)
+		d_string_free(buffer, true);
+}
+
+
 /// Given a filename, remove the extension and replace it with a new one.
 /// The next extension must include the leading '.', e.g. '.html'
 char * filename_with_extension(const char * original, const char * new_extension) {
@@ -152,14 +251,46 @@ char * filename_with_extension(const char * original, const char * new_extension
 }
 
 
-char * mmd_process(DString * buffer, unsigned long extensions, short format, short language) {
-	char * result;
+/// Parse source text, reading it from `stream` (if not NULL) as it arrives
+void mmd_parse(mmd_engine * e, FILE * stream, short language) {
+	mmd_engine_set_language(e, language);
+
+	if (stream) {
+		// Source text is appended to the engine's string as it is read
+		mmd_engine_parse_stream(e, stream_read, stream);
+	} else {
+		mmd_engine_parse_string(e);
+	}
+}
+
 
-	mmd_engine * e = mmd_engine_create_with_dstring(buffer, extensions);
+/// Prepare source text for export.  With `low_memory`, it is only read from
+/// `stream` (if not NULL), since it is parsed a segment at a time as it is
+/// exported.
+void mmd_prepare(mmd_engine * e, DString * buffer, FILE * stream, short language, bool low_memory) {
+	if (!low_memory) {
+		mmd_parse(e, stream, language);
+		return;
+	}
 
 	mmd_engine_set_language(e, language);
 
-	mmd_engine_parse_string(e);
+	if (stream) {
+		// `buffer` is the engine's string
+		char chunk[kBUFFERSIZE];
+		size_t bytes;
+
+		while ((bytes = fread(chunk, 1, kBUFFERSIZE, stream)) > 0) {
+			d_string_append_c_array(buffer, chunk, bytes);
+		}
+	}
+}
+
+
+char * mmd_process(mmd_engine * e, FILE * stream, short format, short language) {
+	char * result;
+
+	mmd_parse(e, stream, language);
 
 	DString * output = d_string_new("");
 
@@ -167,13 +298,360 @@ char * mmd_process(DString * buffer, unsigned long extensions, short format, sho
 
 	result = output->str;
 
-	mmd_engine_free(e, false);
 	d_string_free(output, false);
 
 	return result;
 }
 
 
+/// One file being converted in batch mode, as it passes from stage to stage
+typedef struct {
+	const char *		fname;
+	const char *		source;			//!< Source text (from `map` or `buffer`)
+	size_t				source_len;
+	char *				map;
+	size_t				map_len;
+	DString *			buffer;
+	char *				result;			//!< Converted output
+} batch_file;
+
+
+/// Read a batch file (first stage).  Returns NULL if the file couldn't be read.
+batch_file * batch_read(const char * fname) {
+	batch_file * f = malloc(sizeof(batch_file));
+
+	if (f == NULL)
+		return NULL;
+
+	f->fname = fname;
+	f->result = NULL;
+	f->source = source_for_file(fname, &f->source_len, &f->map, &f->map_len, &f->buffer);
+
+	if (f->source == NULL) {
+		free(f);
+		return NULL;
+	}
+
+	return f;
+}
+
+
+/// Convert a batch file that has been read (second stage).  The source text
+/// is released as soon as it has been converted.
+void batch_convert(mmd_engine * e, batch_file * f, short format, short language) {
+	mmd_engine_reset(e, f->source, f->source_len);
+
+	f->result = mmd_process(e, NULL, format, language);
+
+	release_file(f->map, f->map_len, f->buffer);
+	f->source = NULL;
+}
+
+
+/// Write the output for a converted batch file alongside it, and free it
+/// (last stage)
+void batch_write(batch_file * f, short format) {
+	char * output_filename = NULL;
+	FILE * output_stream;
+
+	// Append output file extension
+	switch (format) {
+		case FORMAT_HTML:
+			output_filename = filename_with_extension(f->fname, ".html");
+			break;
+		default:
+			// No valid format
+			fprintf(stderr, "Unknown output format for '%s'\n", f->fname);
+			free(f->result);
+			free(f);
+			return;
+	}
+
+	if (!(output_stream = fopen(output_filename, "w"))) {
+		// Failed to open file
+		perror(output_filename);
+	} else {
+		fputs(f->result, output_stream);
+		fputc('\n', output_stream);
+		fclose(output_stream);
+	}
+
+	free(output_filename);
+	free(f->result);
+	free(f);
+}
+
+
+/// Files to be processed in batch mode
+typedef struct {
+	struct arg_file *	files;
+	unsigned long		extensions;
+	short				format;
+	short				language;
+	int					failed;			//!< First file that couldn't be read (or the number of files)
+} batch_job;
+
+
+/// Process batch files one at a time (e.g. where threads aren't available)
+void batch_run_sequential(batch_job * job) {
+	mmd_engine * e = mmd_engine_create_with_buffer("", 0, job->extensions);
+	batch_file * f;
+
+	for (int i = 0; i < job->files->count; ++i) {
+		f = batch_read(job->files->filename[i]);
+
+		if (f == NULL) {
+			job->failed = i;
+			break;
+		}
+
+		batch_convert(e, f, job->format, job->language);
+		batch_write(f, job->format);
+	}
+
+	mmd_engine_free(e, false);
+}
+
+
+#ifndef _WIN32
+/// Bounded queue of batch files waiting for the next stage
+typedef struct {
+	batch_file **		items;
+	size_t				capacity;
+	size_t				head;			//!< Next item to be removed
+	size_t				count;
+	bool				closed;			//!< No more items will be added
+	pthread_mutex_t		lock;
+	pthread_cond_t		not_empty;
+	pthread_cond_t		not_full;
+} batch_queue;
+
+
+void batch_queue_init(batch_queue * q, size_t capacity) {
+	q->items = malloc(sizeof(batch_file *) * capacity);
+	q->capacity = capacity;
+	q->head = 0;
+	q->count = 0;
+	q->closed = false;
+
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->not_empty, NULL);
+	pthread_cond_init(&q->not_full, NULL);
+}
+
+
+void batch_queue_destroy(batch_queue * q) {
+	free(q->items);
+
+	pthread_mutex_destroy(&q->lock);
+	pthread_cond_destroy(&q->not_empty);
+	pthread_cond_destroy(&q->not_full);
+}
+
+
+/// Add a file to the queue, waiting while it is full
+void batch_queue_push(batch_queue * q, batch_file * f) {
+	pthread_mutex_lock(&q->lock);
+
+	while (q->count == q->capacity)
+		pthread_cond_wait(&q->not_full, &q->lock);
+
+	q->items[(q->head + q->count) % q->capacity] = f;
+	q->count++;
+
+	pthread_cond_signal(&q->not_empty);
+	pthread_mutex_unlock(&q->lock);
+}
+
+
+/// Remove the oldest file from the queue, waiting while it is empty.
+/// Returns NULL once the queue is empty and closed.
+batch_file * batch_queue_pop(batch_queue * q) {
+	batch_file * f = NULL;
+
+	pthread_mutex_lock(&q->lock);
+
+	while ((q->count == 0) && !q->closed)
+		pthread_cond_wait(&q->not_empty, &q->lock);
+
+	if (q->count) {
+		f = q->items[q->head];
+		q->head = (q->head + 1) % q->capacity;
+		q->count--;
+
+		pthread_cond_signal(&q->not_full);
+	}
+
+	pthread_mutex_unlock(&q->lock);
+
+	return f;
+}
+
+
+/// No more files will be added to the queue
+void batch_queue_close(batch_queue * q) {
+	pthread_mutex_lock(&q->lock);
+
+	q->closed = true;
+
+	pthread_cond_broadcast(&q->not_empty);
+	pthread_mutex_unlock(&q->lock);
+}
+
+
+/// Batch files passed between the reading, converting, and writing stages
+typedef struct {
+	batch_job *			job;
+	batch_queue			read;			//!< Files that have been read, waiting to be converted
+	batch_queue			converted;		//!< Files that have been converted, waiting to be written
+	int					converters;		//!< Number of converting threads still running
+} batch_pipeline;
+
+
+/// Read batch files in order, ahead of the converting threads.  Stops at the
+/// first file that can't be read, as if the files were processed one at a time.
+void * batch_reader(void * context) {
+	batch_pipeline * p = context;
+	batch_file * f;
+
+	for (int i = 0; i < p->job->files->count; ++i) {
+		f = batch_read(p->job->files->filename[i]);
+
+		if (f == NULL) {
+			p->job->failed = i;
+			break;
+		}
+
+		batch_queue_push(&p->read, f);
+	}
+
+	batch_queue_close(&p->read);
+
+	return NULL;
+}
+
+
+/// A converting thread is finished.  Once they all are, nothing more will
+/// be written.
+void batch_converter_done(batch_pipeline * p) {
+	pthread_mutex_lock(&p->converted.lock);
+	bool last = (--p->converters == 0);
+	pthread_mutex_unlock(&p->converted.lock);
+
+	if (last)
+		batch_queue_close(&p->converted);
+}
+
+
+/// Convert batch files as they are read.  Each thread has its own engine
+/// (and token arena).
+void * batch_converter(void * context) {
+	batch_pipeline * p = context;
+	mmd_engine * e = mmd_engine_create_with_buffer("", 0, p->job->extensions);
+	batch_file * f;
+
+	while ((f = batch_queue_pop(&p->read))) {
+		batch_convert(e, f, p->job->format, p->job->language);
+		batch_queue_push(&p->converted, f);
+	}
+
+	mmd_engine_free(e, false);
+
+#ifdef kUseObjectPool
+	token_pool_free();
+#endif
+
+	batch_converter_done(p);
+
+	return NULL;
+}
+#endif
+
+
+/// Process all batch files.  One thread reads files ahead (up to `depth` of
+/// them), `jobs` threads convert them, and this thread writes the output, so
+/// that waiting for disk and converting overlap.
+void batch_run(batch_job * job, int jobs, int depth) {
+#ifndef _WIN32
+	batch_pipeline p;
+	pthread_t reader;
+	pthread_t * converters;
+	pthread_attr_t attr;
+	batch_file * f;
+	int started = 0;
+
+	if (jobs > job->files->count)
+		jobs = job->files->count;
+
+	p.job = job;
+	p.converters = jobs;
+	batch_queue_init(&p.read, depth);
+	batch_queue_init(&p.converted, depth);
+
+	if (pthread_create(&reader, NULL, batch_reader, &p) != 0) {
+		batch_queue_destroy(&p.read);
+		batch_queue_destroy(&p.converted);
+
+		batch_run_sequential(job);
+		return;
+	}
+
+	converters = malloc(sizeof(pthread_t) * jobs);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, kThreadStackSize);
+
+	for (int i = 0; i < jobs; ++i) {
+		if (pthread_create(&converters[started], &attr, batch_converter, &p) == 0)
+			started++;
+		else
+			batch_converter_done(&p);
+	}
+
+	pthread_attr_destroy(&attr);
+
+	if (started) {
+		while ((f = batch_queue_pop(&p.converted)))
+			batch_write(f, job->format);
+	} else {
+		// No threads for converting, so convert files here
+		mmd_engine * e = mmd_engine_create_with_buffer("", 0, job->extensions);
+
+		while ((f = batch_queue_pop(&p.read))) {
+			batch_convert(e, f, job->format, job->language);
+			batch_write(f, job->format);
+		}
+
+		mmd_engine_free(e, false);
+	}
+
+	for (int i = 0; i < started; ++i)
+		pthread_join(converters[i], NULL);
+
+	pthread_join(reader, NULL);
+
+	free(converters);
+	batch_queue_destroy(&p.read);
+	batch_queue_destroy(&p.converted);
+#else
+	batch_run_sequential(job);
+#endif
+}
+
+
+/// Number of batch files to process at once if not specified
+int default_jobs(void) {
+#ifndef _WIN32
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (cores > 0)
+		return (int) cores;
+#endif
+
+	return 1;
+}
+
+
 int main(int argc, char** argv) {
 	int exitcode = EXIT_SUCCESS;
 	char * binname = "multimarkdown";
@@ -191,9 +669,12 @@ int main(int argc, char** argv) {
 		a_o				= arg_file0("o", "output", "FILE", "send output to FILE"),
 
 		a_batch			= arg_lit0("b", "batch", "process each file separately"),
+		a_jobs			= arg_int0("j", "jobs", "N", "process batch files using N threads (default: one per core)"),
+		a_depth			= arg_int0(NULL, "depth", "N", "read up to N batch files ahead (default: 2 per thread)"),
 		a_compatibility	= arg_lit0("c", "compatibility", "Markdown compatibility mode"),
 		a_full			= arg_lit0("f", "full", "force a complete document"),
 		a_snippet		= arg_lit0("s", "snippet", "force a snippet"),
+		a_low_memory	= arg_lit0(NULL, "low-memory", "convert a section at a time to save memory (two passes)"),
 
 		a_rem2			= arg_rem("", ""),
 
@@ -300,6 +781,30 @@ int main(int argc, char** argv) {
 		language = LANG_FROM_STR(a_lang->sval[0]);
 	}
 
+	int jobs = default_jobs();
+
+	if (a_jobs->count > 0) {
+		jobs = a_jobs->ival[0];
+
+		if (jobs < 1) {
+			fprintf(stderr, "%s: Invalid number of jobs '%d'\n", binname, jobs);
+			exitcode = 1;
+			goto exit;
+		}
+	}
+
+	int depth = 2 * jobs;
+
+	if (a_depth->count > 0) {
+		depth = a_depth->ival[0];
+
+		if (depth < 1) {
+			fprintf(stderr, "%s: Invalid depth '%d'\n", binname, depth);
+			exitcode = 1;
+			goto exit;
+		}
+	}
+
 	// Determine input
 	if (a_file->count == 0) {
 		// Read from stdin
@@ -308,53 +813,60 @@ int main(int argc, char** argv) {
 	}
 
 	DString * buffer = NULL;
+	char * map;
+	size_t map_len;
+	const char * source;
+	size_t source_len;
+	mmd_engine * e;
 	char * result;
 	FILE * output_stream;
-	char * output_filename;
-
-	// Prepare token pool
-#ifdef kUseObjectPool
-	token_pool_init();
-#endif
+	bool low_memory = (a_low_memory->count > 0);
 
 	// Determine processing mode -- batch/stdin/files??
 
 	if ((a_batch->count) && (a_file->count)) {
 		// Batch process 1 or more files
-		for (int i = 0; i < a_file->count; ++i)
-		{
-			buffer = scan_file(a_file->filename[i]);
+		batch_job job = { a_file, extensions, format, language, a_file->count };
+
+		batch_run(&job, jobs, depth);
 
-			if (buffer == NULL) {
-				fprintf(stderr, "Error reading file '%s'\n", a_file->filename[i]);
+		if (job.failed < a_file->count) {
+			fprintf(stderr, "Error reading file '%s'\n", a_file->filename[job.failed]);
+			exitcode = 1;
+			goto exit;
+		}
+	} else {
+		map = NULL;
+		result = NULL;
+
+		if (a_file->count == 1) {
+			// Parse a single file in place where possible
+			source = source_for_file(a_file->filename[0], &source_len, &map, &map_len, &buffer);
+
+			if (source == NULL) {
+				fprintf(stderr, "Error reading file '%s'\n", a_file->filename[0]);
 				exitcode = 1;
 				goto exit;
 			}
 
-			// Append output file extension
-			switch (format) {
-				case FORMAT_HTML:
-					output_filename = filename_with_extension(a_file->filename[i], ".html");
-					break;
-			}
+			e = mmd_engine_create_with_buffer(source, source_len, extensions);
 
-			result = mmd_process(buffer, extensions, format, language);
+#ifndef _WIN32
+			if (map && same_file(a_file->filename[0], a_o->filename[0])) {
+				// Output would be written over the text it's rendered from,
+				// so finish rendering first
+				mmd_parse(e, NULL, language);
 
-			if (!(output_stream = fopen(output_filename, "w"))) {
-				// Failed to open file
-				perror(output_filename);
-			} else {
-				fputs(result, output_stream);
-				fputc('\n', output_stream);
-				fclose(output_stream);
+				DString * output = d_string_new("");
+				mmd_export_token_tree(output, e, format);
+				result = output->str;
+				d_string_free(output, false);
 			}
+#endif
 
-			d_string_free(buffer, true);
-			free(result);
-			free(output_filename);
-		}
-	} else {
-		if (a_file->count) {
+			if (result == NULL)
+				mmd_prepare(e, NULL, NULL, language, low_memory);
+		} else if (a_file->count) {
 			// We have files to process
 			buffer = d_string_new("");
 			DString * file_buffer;
@@ -373,12 +885,17 @@ int main(int argc, char** argv) {
 				d_string_append_c_array(buffer, file_buffer->str, file_buffer->currentStringLength);
 				d_string_free(file_buffer, true);
 			}
+
+			e = mmd_engine_create_with_dstring(buffer, extensions);
+			mmd_prepare(e, buffer, NULL, language, low_memory);
 		} else {
-			// Obtain input from stdin
-			buffer = stdin_buffer();
-		}
+			// Obtain input from stdin, tokenizing it as it arrives (unless
+			// it is parsed as it is exported)
+			buffer = d_string_new("");
 
-		result = mmd_process(buffer, extensions, format, language);
+			e = mmd_engine_create_with_dstring(buffer, extensions);
+			mmd_prepare(e, buffer, stdin, language, low_memory);
+		}
 
 		// Where does output go?
 		if (strcmp(a_o->filename[0], "-") == 0) {
@@ -387,21 +904,31 @@ int main(int argc, char** argv) {
 		} else if (!(output_stream = fopen(a_o->filename[0], "w"))) {
 			perror(a_o->filename[0]);
 			free(result);
-			d_string_free(buffer, true);
+			mmd_engine_free(e, false);
+			release_file(map, map_len, buffer);
 	
 			exitcode = 1;
 			goto exit;
 		}
 
-		fputs(result, output_stream);
+		if (result) {
+			fputs(result, output_stream);
+			free(result);
+		} else if (low_memory) {
+			// Output is written as each segment is rendered
+			mmd_export_segments_to_file(e, format, output_stream, kOutputFlushThreshold);
+		} else {
+			// Output is written as it is rendered
+			mmd_export_token_tree_to_file(e, format, output_stream, kOutputFlushThreshold);
+		}
+
 		fputc('\n', output_stream);
 		
 		if (output_stream != stdout)
 			fclose(output_stream);
 		
-		d_string_free(buffer, true);
-
-		free(result);
+		mmd_engine_free(e, false);
+		release_file(map, map_len, buffer);
 	}
 
 
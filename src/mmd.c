@@ -68,16 +68,40 @@
 #include "stack.h"
 #include "token.h"
 #include "token_pairs.h"
+#include "token_store.h"
 #include "writer.h"
 
 
+#define kStreamChunkSize 4096	// How many bytes to read at a time when streaming
+
+#ifndef kMaxParseDepth
+	#define kMaxParseDepth 1000		// How deeply to nest blockquotes and lists before treating as text
+#endif
+
+
 // Basic parser function declarations
 void * ParseAlloc();
 void Parse();
 void ParseFree();
 
-void mmd_pair_tokens_in_block(token * block, token_pair_engine * e, stack * s);
+void mmd_pair_tokens_in_block(token * block, const token_pair_engine * e, stack * s, token_store * ts);
+void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, const char * str, size_t start_offset);
+
+static unsigned short mmd_inline_categories_for_pairings(const token_pair_engine * e);
+
 
+/// Choose token pairs to match, based on the engine's extensions.  These are
+/// shared, read-only tables (see token_pairs_lookup.c)
+static void mmd_engine_set_pairings(mmd_engine * e) {
+	e->pairings1 = (e->extensions & EXT_CRITIC) ? &kPairingsCritic : &kPairingsNone;
+	e->pairings2 = (e->extensions & EXT_COMPATIBILITY) ? &kPairingsBracketsCompat : &kPairingsBrackets;
+	e->pairings3 = (e->extensions & EXT_COMPATIBILITY) ? &kPairingsEmphasisCompat : &kPairingsEmphasis;
+
+	// Blocks without any of these can skip a pairing pass
+	e->pairing_categories[0] = mmd_inline_categories_for_pairings(e->pairings1);
+	e->pairing_categories[1] = mmd_inline_categories_for_pairings(e->pairings2);
+	e->pairing_categories[2] = mmd_inline_categories_for_pairings(e->pairings3);
+}
 
 
 /// Build MMD Engine
@@ -87,15 +111,23 @@ mmd_engine * mmd_engine_create(DString * d, unsigned long extensions) {
 	if (e) {
 		e->dstr = d;
 
+		e->borrowed_source = false;
+
 		e->root = NULL;
 
 		e->extensions = extensions;
 
 		e->allow_meta = (extensions & EXT_COMPATIBILITY) ? false : true;
+		e->assign_ambidextrous = true;
 
 		e->language = LC_EN;
 		e->quotes_lang = ENGLISH;
 
+#ifdef kUseObjectPool
+		// Each engine owns the tokens in its parse tree
+		e->token_pool = token_pool_new();
+#endif
+
 		e->citation_stack = stack_new(0);
 		e->definition_stack = stack_new(0);
 		e->footnote_stack = stack_new(0);
@@ -103,55 +135,15 @@ mmd_engine * mmd_engine_create(DString * d, unsigned long extensions) {
 		e->link_stack = stack_new(0);
 		e->metadata_stack = stack_new(0);
 
-		e->pairings1 = token_pair_engine_new();
-		e->pairings2 = token_pair_engine_new();
-		e->pairings3 = token_pair_engine_new();
-
-		// CriticMarkup
-		if (extensions & EXT_CRITIC) {
-			token_pair_engine_add_pairing(e->pairings1, CRITIC_ADD_OPEN, CRITIC_ADD_CLOSE, PAIR_CRITIC_ADD, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-			token_pair_engine_add_pairing(e->pairings1, CRITIC_DEL_OPEN, CRITIC_DEL_CLOSE, PAIR_CRITIC_DEL, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-			token_pair_engine_add_pairing(e->pairings1, CRITIC_COM_OPEN, CRITIC_COM_CLOSE, PAIR_CRITIC_COM, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-			token_pair_engine_add_pairing(e->pairings1, CRITIC_SUB_OPEN, CRITIC_SUB_DIV_A, PAIR_CRITIC_SUB_DEL, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-			token_pair_engine_add_pairing(e->pairings1, CRITIC_SUB_DIV_B, CRITIC_SUB_CLOSE, PAIR_CRITIC_SUB_ADD, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-			token_pair_engine_add_pairing(e->pairings1, CRITIC_HI_OPEN, CRITIC_HI_CLOSE, PAIR_CRITIC_HI, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-		}
+		// Parsers are created as needed, and reused for each nesting depth
+		e->parser_stack = stack_new(0);
+		e->parser_depth = 0;
 
-		// Brackets, Parentheses, Angles
-		token_pair_engine_add_pairing(e->pairings2, BRACKET_LEFT, BRACKET_RIGHT, PAIR_BRACKET, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-		token_pair_engine_add_pairing(e->pairings2, BRACKET_CITATION_LEFT, BRACKET_RIGHT, PAIR_BRACKET_CITATION, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-		token_pair_engine_add_pairing(e->pairings2, BRACKET_FOOTNOTE_LEFT, BRACKET_RIGHT, PAIR_BRACKET_FOOTNOTE, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-		token_pair_engine_add_pairing(e->pairings2, BRACKET_IMAGE_LEFT, BRACKET_RIGHT, PAIR_BRACKET_IMAGE, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-		token_pair_engine_add_pairing(e->pairings2, BRACKET_VARIABLE_LEFT, BRACKET_RIGHT, PAIR_BRACKET_VARIABLE, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-		token_pair_engine_add_pairing(e->pairings2, PAREN_LEFT, PAREN_RIGHT, PAIR_PAREN, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-		token_pair_engine_add_pairing(e->pairings2, ANGLE_LEFT, ANGLE_RIGHT, PAIR_ANGLE, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-		token_pair_engine_add_pairing(e->pairings2, BRACE_DOUBLE_LEFT, BRACE_DOUBLE_RIGHT, PAIR_BRACES, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-
-		// Strong/Emph
-		token_pair_engine_add_pairing(e->pairings3, STAR, STAR, PAIR_STAR, 0);
-		token_pair_engine_add_pairing(e->pairings3, UL, UL, PAIR_UL, 0);
-
-		// Quotes and Backticks
-		token_pair_engine_add_pairing(e->pairings2, BACKTICK, BACKTICK, PAIR_BACKTICK, PAIRING_PRUNE_MATCH | PAIRING_MATCH_LENGTH);
-
-		token_pair_engine_add_pairing(e->pairings3, BACKTICK,   QUOTE_RIGHT_ALT,   PAIR_QUOTE_ALT, PAIRING_ALLOW_EMPTY | PAIRING_MATCH_LENGTH);
-		token_pair_engine_add_pairing(e->pairings3, QUOTE_SINGLE, QUOTE_SINGLE, PAIR_QUOTE_SINGLE, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-		token_pair_engine_add_pairing(e->pairings3, QUOTE_DOUBLE, QUOTE_DOUBLE, PAIR_QUOTE_DOUBLE, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-
-		// Math
-		if (!(extensions & EXT_COMPATIBILITY)) {
-			token_pair_engine_add_pairing(e->pairings2, MATH_PAREN_OPEN, MATH_PAREN_CLOSE, PAIR_MATH, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-			token_pair_engine_add_pairing(e->pairings2, MATH_BRACKET_OPEN, MATH_BRACKET_CLOSE, PAIR_MATH, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-			token_pair_engine_add_pairing(e->pairings2, MATH_DOLLAR_SINGLE, MATH_DOLLAR_SINGLE, PAIR_MATH, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-			token_pair_engine_add_pairing(e->pairings2, MATH_DOLLAR_DOUBLE, MATH_DOLLAR_DOUBLE, PAIR_MATH, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
-		}
-	
-		// Superscript/Subscript
-		if (!(extensions & EXT_COMPATIBILITY)) {
-			token_pair_engine_add_pairing(e->pairings3, SUPERSCRIPT, SUPERSCRIPT, PAIR_SUPERSCRIPT, 0);
-			token_pair_engine_add_pairing(e->pairings3, SUBSCRIPT, SUBSCRIPT, PAIR_SUPERSCRIPT, 0);
-		}
+		e->line_masks = NULL;
+		e->line_count = 0;
+		e->line_capacity = 0;
 
+		mmd_engine_set_pairings(e);
 	}
 
 	return e;
@@ -172,6 +164,45 @@ mmd_engine * mmd_engine_create_with_string(const char * str, unsigned long exten
 }
 
 
+/// Create MMD Engine that parses a caller-owned buffer in place (e.g. a
+/// memory-mapped file).  No copy is made, and the buffer must stay valid and
+/// unchanged until the engine is freed.
+mmd_engine * mmd_engine_create_with_buffer(const char * str, size_t len, unsigned long extensions) {
+	DString * d = malloc(sizeof(DString));
+
+	if (d == NULL)
+		return NULL;
+
+	// Wrap the buffer without taking ownership of it
+	d->str = (char *) str;
+	d->currentStringLength = len;
+	d->currentStringBufferSize = 0;
+
+	mmd_engine * e = mmd_engine_create(d, extensions);
+
+	if (e)
+		e->borrowed_source = true;
+	else
+		free(d);
+
+	return e;
+}
+
+
+#ifdef kUseObjectPool
+/// Token arena used by this engine
+struct pool * mmd_engine_token_pool(mmd_engine * e) {
+	return e->token_pool;
+}
+#endif
+
+
+/// Number of lemon parsers this engine has created
+size_t mmd_engine_parser_count(mmd_engine * e) {
+	return e->parser_stack->size;
+}
+
+
 /// Set language and smart quotes language
 void mmd_engine_set_language(mmd_engine * e, short language) {
 	e->language = language;
@@ -192,44 +223,108 @@ void mmd_engine_set_language(mmd_engine * e, short language) {
 }
 
 
-/// Free an existing MMD Engine
-void mmd_engine_free(mmd_engine * e, bool freeDString) {
-	if (e == NULL)
-		return;
-
-	if (freeDString)
-		d_string_free(e->dstr, true);
-
-	if (e->extensions & EXT_CRITIC)
-		token_pair_engine_free(e->pairings1);
-	
-	token_pair_engine_free(e->pairings2);
-	token_pair_engine_free(e->pairings3);
-
-	token_tree_free(e->root);
-
+/// Free everything found by the last parse (links, footnotes, metadata, etc.),
+/// but keep the stacks for the next parse
+static void mmd_engine_clear_definitions(mmd_engine * e) {
 	// Pointers to blocks that are freed elsewhere
-	stack_free(e->definition_stack);
-	stack_free(e->header_stack);
+	e->citation_stack->size = 0;
+	e->definition_stack->size = 0;
+	e->header_stack->size = 0;
 
 	// Links need to be freed
 	while (e->link_stack->size) {
 		link_free(stack_pop(e->link_stack));
 	}
-	stack_free(e->link_stack);
 
 	// Footnotes need to be freed
 	while (e->footnote_stack->size) {
 		footnote_free(stack_pop(e->footnote_stack));
 	}
-	stack_free(e->footnote_stack);
 
 	// Metadata needs to be freed
 	while (e->metadata_stack->size) {
 		meta_free(stack_pop(e->metadata_stack));
 	}
+}
+
+
+/// Reset an existing MMD Engine to parse new source text
+void mmd_engine_reset(mmd_engine * e, const char * str, size_t len) {
+	if (e == NULL)
+		return;
+
+	token_tree_free(e->root);
+	e->root = NULL;
+
+	mmd_engine_clear_definitions(e);
+
+#ifdef kUseObjectPool
+	// Tokens from the last parse are no longer used, but their slabs are
+	pool_reset(e->token_pool);
+#endif
+
+	e->allow_meta = (e->extensions & EXT_COMPATIBILITY) ? false : true;
+	e->assign_ambidextrous = true;
+	e->parser_depth = 0;
+	e->line_count = 0;
+
+	if (e->borrowed_source) {
+		// Parse the new buffer in place
+		e->dstr->str = (char *) str;
+		e->dstr->currentStringLength = len;
+	} else {
+		// Reuse the existing string
+		d_string_erase(e->dstr, 0, -1);
+		d_string_append_c_array(e->dstr, str, len);
+	}
+}
+
+
+/// Change the extensions used by an MMD Engine
+void mmd_engine_set_extensions(mmd_engine * e, unsigned long extensions) {
+	e->extensions = extensions;
+	e->allow_meta = (extensions & EXT_COMPATIBILITY) ? false : true;
+
+	mmd_engine_set_pairings(e);
+}
+
+
+/// Free an existing MMD Engine
+void mmd_engine_free(mmd_engine * e, bool freeDString) {
+	if (e == NULL)
+		return;
+
+	if (e->borrowed_source) {
+		// Free the wrapper, but not the caller's buffer
+		free(e->dstr);
+	} else if (freeDString) {
+		d_string_free(e->dstr, true);
+	}
+
+	token_tree_free(e->root);
+
+	mmd_engine_clear_definitions(e);
+
+	stack_free(e->citation_stack);
+	stack_free(e->definition_stack);
+	stack_free(e->header_stack);
+	stack_free(e->link_stack);
+	stack_free(e->footnote_stack);
 	stack_free(e->metadata_stack);
 
+	// Parsers need to be freed
+	while (e->parser_stack->size) {
+		ParseFree(stack_pop(e->parser_stack), free);
+	}
+	stack_free(e->parser_stack);
+
+	free(e->line_masks);
+
+#ifdef kUseObjectPool
+	// Free all tokens belonging to this engine
+	token_pool_release(e->token_pool);
+#endif
+
 	free(e);
 }
 
@@ -660,47 +755,321 @@ void strip_quote_markers_from_block(mmd_engine * e, token * block) {
 }
 
 
-/// Create a token chain from source string
-token * mmd_tokenize_string(mmd_engine * e, const char * str, size_t len) {
+/// Where will the parser be, relative to fenced code blocks, after each line?
+/// This mirrors the parser tables in parser.y for the top level of a document.
+enum fence_states {
+	FENCE_OUTSIDE,			//!< Not in a fenced code block
+	FENCE_HTML,				//!< In an HTML block (where fences are treated as HTML)
+	FENCE_OPENED,			//!< Opening fence line, but no contents yet
+	FENCE_CONTENTS,			//!< Contents of fenced code block
+};
+
+
+/// Determine parser fence state after a line of the specified type
+static short mmd_fence_state_next(short state, unsigned short line_type) {
+	switch (state) {
+		case FENCE_OPENED:
+		case FENCE_CONTENTS:
+			switch (line_type) {
+				case LINE_CONTINUATION:
+				case LINE_EMPTY:
+				case LINE_INDENTED_SPACE:
+				case LINE_INDENTED_TAB:
+				case LINE_PLAIN:
+					return FENCE_CONTENTS;
+				case LINE_FENCE_BACKTICK:
+					if (state == FENCE_CONTENTS)
+						return FENCE_OUTSIDE;
+					break;
+			}
+
+			if (state == FENCE_OPENED) {
+				// Syntax error -- line is discarded and fence is still open
+				return FENCE_OPENED;
+			}
+
+			// Anything else ends the fenced block without being part of it
+			return mmd_fence_state_next(FENCE_OUTSIDE, line_type);
+		case FENCE_HTML:
+			switch (line_type) {
+				case LINE_EMPTY:
+				case LINE_META:
+					return FENCE_OUTSIDE;
+			}
+
+			// Everything else (including fences) is part of the HTML block
+			return FENCE_HTML;
+		default:
+			switch (line_type) {
+				case LINE_FENCE_BACKTICK:
+				case LINE_FENCE_BACKTICK_START:
+					return FENCE_OPENED;
+				case LINE_HTML:
+					return FENCE_HTML;
+			}
+
+			return FENCE_OUTSIDE;
+	}
+}
+
+
+/// Replace the contents of a line inside a fenced code block with a single
+/// TEXT_RAW token, moving the unused tokens to the `spares` chain.  Leading
+/// indentation and the trailing newline are left in place.
+static void mmd_collapse_fenced_line(token * line, token ** spares) {
+	token * first = line->child;
+
+	if (first == NULL)
+		return;
+
+	switch (first->type) {
+		case INDENT_SPACE:
+		case INDENT_TAB:
+		case NON_INDENT_SPACE:
+			// strip_line_tokens_from_block() may remove this
+			first = first->next;
+			break;
+	}
+
+	token * last = NULL;
+	token * walker = first;
+
+	while (walker) {
+		switch (walker->type) {
+			case TEXT_LINEBREAK:
+			case TEXT_NL:
+				walker = NULL;
+				continue;
+			case CRITIC_COM_OPEN:
+			case CRITIC_COM_CLOSE:
+			case CRITIC_SUB_DIV:
+			case TEXT_EMPTY:
+				// These are not printed as escaped text in code blocks
+				return;
+		}
+
+		last = walker;
+		walker = walker->next;
+	}
+
+	if ((last == NULL) || (last == first))
+		return;
+
+	first->type = TEXT_RAW;
+	first->len = last->start + last->len - first->start;
+
+	// Move remaining tokens to spares chain
+	walker = first->next;
+
+	first->next = last->next;
+
+	if (first->next)
+		first->next->prev = first;
+	else
+		line->child->tail = first;
+
+	last->next = *spares;
+	*spares = walker;
+}
+
+
+/// Is this token type only meaningful for smart typography?  If so, it can
+/// be folded into the surrounding plain text when found inside a word.
+static bool mmd_token_type_is_inert(unsigned short type) {
+	switch (type) {
+		case COLON:
+		case DASH_M:
+		case DASH_N:
+		case ELLIPSIS:
+		case TEXT_PERIOD:
+			return true;
+		default:
+			return false;
+	}
+}
+
+
+/// Categories of tokens used by the inline passes (ambidextrous tokens,
+/// pairing, and strong/emph).  These are recorded for each line, so that
+/// blocks can skip the passes that have nothing to do.
+enum inline_categories {
+	INLINE_CRITIC		= 1 << 0,		//!< CriticMarkup
+	INLINE_BRACKET		= 1 << 1,		//!< Brackets, parentheses, angles, and braces
+	INLINE_MATH			= 1 << 2,		//!< Math delimiters
+	INLINE_EMPH			= 1 << 3,		//!< `*` and `_`
+	INLINE_BACKTICK		= 1 << 4,		//!< Code spans and ``quotes''
+	INLINE_QUOTE		= 1 << 5,		//!< Single and double quotes
+	INLINE_SCRIPT		= 1 << 6,		//!< Superscript and subscript
+	INLINE_DASH			= 1 << 7,		//!< Hyphens that might be en-dashes
+	INLINE_ALL			= 0xFFFF,
+};
+
+/// Categories checked by `mmd_assign_ambidextrous_tokens_in_block()`
+#define kInlineAmbidextrous (INLINE_CRITIC | INLINE_EMPH | INLINE_BACKTICK | INLINE_QUOTE | INLINE_MATH | INLINE_SCRIPT | INLINE_DASH)
+
+
+/// Which inline category does this token type belong to?  Any token type that
+/// can open a pair, or that is checked for ambidextrous behavior, needs one.
+static unsigned short mmd_inline_category(unsigned short type) {
+	switch (type) {
+		case CRITIC_ADD_OPEN:
+		case CRITIC_DEL_OPEN:
+		case CRITIC_COM_OPEN:
+		case CRITIC_SUB_OPEN:
+		case CRITIC_SUB_DIV:
+		case CRITIC_SUB_DIV_A:
+		case CRITIC_SUB_DIV_B:
+		case CRITIC_HI_OPEN:
+			return INLINE_CRITIC;
+		case BRACKET_LEFT:
+		case BRACKET_CITATION_LEFT:
+		case BRACKET_FOOTNOTE_LEFT:
+		case BRACKET_IMAGE_LEFT:
+		case BRACKET_VARIABLE_LEFT:
+		case PAREN_LEFT:
+		case ANGLE_LEFT:
+		case BRACE_DOUBLE_LEFT:
+			return INLINE_BRACKET;
+		case MATH_PAREN_OPEN:
+		case MATH_BRACKET_OPEN:
+		case MATH_DOLLAR_SINGLE:
+		case MATH_DOLLAR_DOUBLE:
+			return INLINE_MATH;
+		case STAR:
+		case UL:
+			return INLINE_EMPH;
+		case BACKTICK:
+			return INLINE_BACKTICK;
+		case QUOTE_SINGLE:
+		case QUOTE_DOUBLE:
+			return INLINE_QUOTE;
+		case SUPERSCRIPT:
+		case SUBSCRIPT:
+			return INLINE_SCRIPT;
+		case DASH_N:
+			return INLINE_DASH;
+		default:
+			return 0;
+	}
+}
+
+
+/// Which inline categories does a pairing engine need in order to find a pair?
+static unsigned short mmd_inline_categories_for_pairings(const token_pair_engine * e) {
+	unsigned short mask = 0;
+
+	for (int i = 0; i < kMaxTokenTypes; ++i) {
+		if (e->can_open_pair[e->slot[i]]) {
+			if (mmd_inline_category(i) == 0)
+				return INLINE_ALL;	// Don't know when this opener is present
+
+			mask |= mmd_inline_category(i);
+		}
+	}
+
+	return mask;
+}
+
+
+/// Tokenizer state that is kept between calls to `mmd_tokenize_range()`, so
+/// that source text can be tokenized as it arrives
+typedef struct {
+	token *			root;				//!< Store the final parse tree here
+	token *			line;				//!< Store current line here
+	size_t			last_stop;			//!< Remember where last token ended
+	short			fence_state;		//!< Track fenced code blocks
+	bool			fold_inert;			//!< Fold inert punctuation into plain text?
+	token *			spares;				//!< Tokens discarded from fenced code blocks
+	unsigned short	line_mask;			//!< Inline token categories on current line
+} tokenizer;
+
+
+/// Prepare tokenizer state for text starting at `start`
+static void mmd_tokenizer_init(mmd_engine * e, tokenizer * tz, size_t start) {
+	tz->root = token_new(0,0,0);
+	tz->line = token_new(0, start, 0);
+	tz->last_stop = start;
+	tz->fence_state = FENCE_OUTSIDE;
+	tz->fold_inert = !(e->extensions & EXT_SMART);
+	tz->spares = NULL;
+	tz->line_mask = 0;
+
+	e->line_count = 0;
+}
+
+
+/// Add the current line to the token tree
+static void mmd_tokenizer_end_line(mmd_engine * e, tokenizer * tz) {
+	// What sort of line is this?
+	mmd_assign_line_type(e, tz->line);
+
+	// Contents of fenced code blocks are only printed verbatim, so we
+	// don't need to keep individual tokens
+	tz->fence_state = mmd_fence_state_next(tz->fence_state, tz->line->type);
+
+	if (tz->fence_state == FENCE_CONTENTS)
+		mmd_collapse_fenced_line(tz->line, &tz->spares);
+
+	token_append_child(tz->root, tz->line);
+
+	// Remember which inline tokens were on this line
+	if (e->line_count == e->line_capacity) {
+		e->line_capacity = (e->line_capacity) ? e->line_capacity * 2 : 256;
+		e->line_masks = realloc(e->line_masks, sizeof(line_mask) * e->line_capacity);
+	}
+
+	e->line_masks[e->line_count].start = tz->line->start;
+	e->line_masks[e->line_count].mask = tz->line_mask;
+	e->line_count++;
+
+	tz->line_mask = 0;
+}
+
+
+/// Tokenize source text from `tz->last_stop` to `end`, with offsets relative
+/// to `str`.  Unless `finish` is true, `end` must fall immediately after a
+/// line ending, so that more text can be tokenized later.  (The lexer never
+/// matches across a line ending, so tokens are the same either way.)
+static void mmd_tokenize_range(mmd_engine * e, tokenizer * tz, const char * str, size_t end, bool finish) {
 	// Create a scanner (for re2c)
 	Scanner s;
-	s.start = str;
+	s.start = str + tz->last_stop;
 	s.cur = s.start;
 
-	// Strip trailing whitespace
-//	while (len && char_is_whitespace_or_line_ending(str[len - 1]))
-//		len--;
-	
 	// Where do we stop parsing?
-	const char * stop = str + len;
+	const char * stop = str + end;
 
 	int type;								// TOKEN type
 	token * t;								// Create tokens for incorporation
 
-	token * root = token_new(0,0,0);		// Store the final parse tree here
-	token * line = token_new(0,0,0);		// Store current line here
-
-	const char * last_stop = str;			// Remember where last token ended
+	const char * last_stop = s.start;		// Remember where last token ended
 
 	do {
 		// Scan for next token (type of 0 means there is nothing left);
 		type = scan(&s, stop);
 
+		if (tz->fold_inert && (s.start > last_stop) && char_is_alphanumeric(s.start[-1]) &&
+			mmd_token_type_is_inert(type)) {
+			// Punctuation inside a word (e.g. `a-b`, `a:b`) can't pair with anything
+			// when smart typography is off, so leave it in the current TEXT_PLAIN span
+			continue;
+		}
+
 		//if (type && s.start != last_stop) {
         if (s.start != last_stop) {
 			// We skipped characters between tokens
 
             if (type) {
 				// Create a default token type for the skipped characters
-				t = token_new(TEXT_PLAIN, (size_t)(last_stop - str), (size_t)(s.start - last_stop));
+				t = token_new_from_spares(&tz->spares, TEXT_PLAIN, (size_t)(last_stop - str), (size_t)(s.start - last_stop));
 
-				token_append_child(line, t);
+				token_append_child(tz->line, t);
             } else {
 				if (stop > last_stop) {
 					// Source text ends without newline
-					t = token_new(TEXT_PLAIN, (size_t)(last_stop - str), (size_t)(stop - last_stop));
+					t = token_new_from_spares(&tz->spares, TEXT_PLAIN, (size_t)(last_stop - str), (size_t)(stop - last_stop));
                 
-					token_append_child(line, t);
+					token_append_child(tz->line, t);
 				}
             }
 		}
@@ -708,28 +1077,25 @@ token * mmd_tokenize_string(mmd_engine * e, const char * str, size_t len) {
 		switch (type) {
 			case 0:
 				// 0 means we finished with input
-				// Add current line to root
-
-				// What sort of line is this?
-				mmd_assign_line_type(e, line);
-
-				token_append_child(root, line);
+				// Add current line to root, unless more text is coming
+				if (finish)
+					mmd_tokenizer_end_line(e, tz);
 				break;
 			case TEXT_LINEBREAK:
 			case TEXT_NL:
 				// We hit the end of a line
-				t = token_new(type, (size_t)(s.start - str), (size_t)(s.cur - s.start));
-				token_append_child(line, t);
+				t = token_new_from_spares(&tz->spares, type, (size_t)(s.start - str), (size_t)(s.cur - s.start));
+				token_append_child(tz->line, t);
 
-				// What sort of line is this?
-				mmd_assign_line_type(e, line);
+				mmd_tokenizer_end_line(e, tz);
 
-				token_append_child(root, line);
-				line = token_new(0,s.cur - str,0);
+				tz->line = token_new_from_spares(&tz->spares, 0, s.cur - str, 0);
 				break;
 			default:
-				t = token_new(type, (size_t)(s.start - str), (size_t)(s.cur - s.start));
-				token_append_child(line, t);
+				t = token_new_from_spares(&tz->spares, type, (size_t)(s.start - str), (size_t)(s.cur - s.start));
+				token_append_child(tz->line, t);
+
+				tz->line_mask |= mmd_inline_category(type);
 				break;
 		}
 
@@ -737,15 +1103,36 @@ token * mmd_tokenize_string(mmd_engine * e, const char * str, size_t len) {
 		last_stop = s.cur;
 	} while (type != 0);
 
-	
-	return root;
+	tz->last_stop = (size_t)(last_stop - str);
+
+	if (finish) {
+		token_tree_free(tz->spares);
+		tz->spares = NULL;
+	}
+}
+
+
+/// Create a token chain from source string
+token * mmd_tokenize_string(mmd_engine * e, const char * str, size_t len) {
+	tokenizer tz;
+
+	mmd_tokenizer_init(e, &tz, 0);
+	mmd_tokenize_range(e, &tz, str, len, true);
+
+	return tz.root;
 }
 
 
 /// Parse token tree
 void mmd_parse_token_chain(mmd_engine * e, token * chain) {
 
-	void* pParser = ParseAlloc (malloc);		// Create a parser (for lemon)
+	// Lists and blockquotes are parsed recursively, so each nesting depth
+	// needs its own parser.  A parser is back in its initial state after the
+	// end of input, so it can be reused by the next block at the same depth.
+	if (e->parser_depth == e->parser_stack->size)
+		stack_push(e->parser_stack, ParseAlloc(malloc));
+
+	void* pParser = stack_peek_index(e->parser_stack, e->parser_depth++);
 	token * walker = chain->child;				// Walk the existing tree
 	token * remainder;							// Hold unparsed tail of chain
 
@@ -775,14 +1162,14 @@ void mmd_parse_token_chain(mmd_engine * e, token * chain) {
 	token_append_child(chain, e->root);
 	e->root = NULL;
 
-	ParseFree(pParser, free);
+	e->parser_depth--;
 }
 
 
-void mmd_pair_tokens_in_chain(token * head, token_pair_engine * e, stack * s) {
+void mmd_pair_tokens_in_chain(token * head, const token_pair_engine * e, stack * s, token_store * ts) {
 
 	while (head != NULL) {
-		mmd_pair_tokens_in_block(head, e, s);
+		mmd_pair_tokens_in_block(head, e, s, ts);
 
 		head = head->next;
 	}
@@ -790,7 +1177,7 @@ void mmd_pair_tokens_in_chain(token * head, token_pair_engine * e, stack * s) {
 
 
 /// Match token pairs inside block
-void mmd_pair_tokens_in_block(token * block, token_pair_engine * e, stack * s) {
+void mmd_pair_tokens_in_block(token * block, const token_pair_engine * e, stack * s, token_store * ts) {
 	if (block == NULL || e == NULL)
 		return;
 
@@ -806,25 +1193,25 @@ void mmd_pair_tokens_in_block(token * block, token_pair_engine * e, stack * s) {
 		case BLOCK_H5:
 		case BLOCK_H6:
 		case BLOCK_PARA:
-			token_pairs_match_pairs_inside_token(block, e, s);
+			token_pairs_match_pairs_inside_token(block, e, s, ts);
 			break;
 		case DOC_START_TOKEN:
 		case BLOCK_LIST_BULLETED:
 		case BLOCK_LIST_BULLETED_LOOSE:
 		case BLOCK_LIST_ENUMERATED:
 		case BLOCK_LIST_ENUMERATED_LOOSE:
-			mmd_pair_tokens_in_chain(block->child, e, s);
+			mmd_pair_tokens_in_chain(block->child, e, s, ts);
 			break;
 		case BLOCK_LIST_ITEM:
 		case BLOCK_LIST_ITEM_TIGHT:
-			token_pairs_match_pairs_inside_token(block, e, s);
-			mmd_pair_tokens_in_chain(block->child, e, s);
+			token_pairs_match_pairs_inside_token(block, e, s, ts);
+			mmd_pair_tokens_in_chain(block->child, e, s, ts);
 			break;
 		case LINE_TABLE:
 		case BLOCK_TABLE:
 			// TODO: Need to parse into cells first
-			token_pairs_match_pairs_inside_token(block, e, s);
-			mmd_pair_tokens_in_chain(block->child, e, s);
+			token_pairs_match_pairs_inside_token(block, e, s, ts);
+			mmd_pair_tokens_in_chain(block->child, e, s, ts);
 			break;
 		case BLOCK_EMPTY:
 		case BLOCK_CODE_INDENTED:
@@ -836,20 +1223,29 @@ void mmd_pair_tokens_in_block(token * block, token_pair_engine * e, stack * s) {
 }
 
 
+/// Character at `offset` in a string of length `len`, or '\0' past the end
+static inline char mmd_char_at(const char * str, size_t len, size_t offset) {
+	return (offset < len) ? str[offset] : '\0';
+}
+
+
 /// Ambidextrous tokens can open OR close a pair.  This routine gives the opportunity
 /// to change this behavior on case-by-case basis.  For example, in `foo **bar** foo`, the 
 /// first set of asterisks can open, but not close a pair.  The second set can close, but not
 /// open a pair.  This allows for complex behavior without having to bog down the tokenizer
 /// with figuring out which type of asterisk we have.  Default behavior is that open and close
 /// are enabled, so we just have to figure out when to turn it off.
-void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, const char * str, size_t start_offset) {
-	if (block == NULL || block->child == NULL)
-		return;
-
+///
+/// Tokens are checked starting with `t`, through `last` (or the end of the
+/// chain).  Returns false if metadata stopped the walk, in which case the
+/// rest of the document is not checked either.
+static bool mmd_assign_ambidextrous_tokens_in_chain(mmd_engine * e, token * t, token * last, const char * str, size_t start_offset) {
 	size_t offset;		// Temp variable for use below
 	size_t lead_count, lag_count, pre_count, post_count;
-	
-	token * t = block->child;
+
+	// Looking past the end of the source text finds '\0', as if it were
+	// NUL-terminated
+	size_t str_len = e->dstr->currentStringLength - (size_t)(str - e->dstr->str);
 
 	while (t != NULL) {
 		switch (t->type) {
@@ -857,7 +1253,7 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 				// Do we treat this like metadata?
 				if (!(e->extensions & EXT_COMPATIBILITY) &&
 					!(e->extensions & EXT_NO_METADATA))
-					return;
+					return false;
 				// This is not metadata
 				t->type = BLOCK_PARA;
 			case DOC_START_TOKEN:
@@ -892,12 +1288,12 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 				// Look left and skip over neighboring '*' characters
 				offset = t->start;
 				
-				while ((offset != 0) && ((str[offset] == '*') || (str[offset] == '_'))) {
+				while ((offset != 0) && ((mmd_char_at(str, str_len, offset) == '*') || (mmd_char_at(str, str_len, offset) == '_'))) {
 					offset--;
 				}
 				
 				// We can only close if there is something to left besides whitespace
-				if ((offset == 0) || (char_is_whitespace_or_line_ending(str[offset]))) {
+				if ((offset == 0) || (char_is_whitespace_or_line_ending(mmd_char_at(str, str_len, offset)))) {
 					// Whitespace or punctuation to left, so can't close
 					t->can_close = 0;
 				}
@@ -905,11 +1301,11 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 				// Look right and skip over neighboring '*' characters
 				offset = t->start + 1;
 				
-				while ((str[offset] == '*') || (str[offset] == '_'))
+				while ((mmd_char_at(str, str_len, offset) == '*') || (mmd_char_at(str, str_len, offset) == '_'))
 					offset++;
 				
 				// We can only open if there is something to right besides whitespace/punctuation
-				if (char_is_whitespace_or_line_ending(str[offset])) {
+				if (char_is_whitespace_or_line_ending(mmd_char_at(str, str_len, offset))) {
 					// Whitespace to right, so can't open
 					t->can_open = 0;
 				}
@@ -924,17 +1320,17 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 					offset = t->start - 1;
 
 					// How many '*' in this run before current token?
-					while (offset && (str[offset] == '*')) {
+					while (offset && (mmd_char_at(str, str_len, offset) == '*')) {
 						lead_count++;
 						offset--;
 					}
 
-					while (offset && (!char_is_whitespace_or_line_ending_or_punctuation(str[offset]))) {
+					while (offset && (!char_is_whitespace_or_line_ending_or_punctuation(mmd_char_at(str, str_len, offset)))) {
 						offset--;
 					}
 
 					// Are there '*' at the beginning of this word?
-					while ((offset != -1) && (str[offset] == '*')) {
+					while ((offset != -1) && (mmd_char_at(str, str_len, offset) == '*')) {
 						pre_count++;
 						offset--;
 					}
@@ -942,17 +1338,17 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 					offset = t->start + 1;
 
 					// How many '*' in this run after current token?
-					while (str[offset] == '*') {
+					while (mmd_char_at(str, str_len, offset) == '*') {
 						lag_count++;
 						offset++;
 					}
 
-					while (!char_is_whitespace_or_line_ending_or_punctuation(str[offset])) {
+					while (!char_is_whitespace_or_line_ending_or_punctuation(mmd_char_at(str, str_len, offset))) {
 						offset++;
 					}
 
 					// Are there '*' at the end of this word?
-					while (offset && (str[offset] == '*')) {
+					while (offset && (mmd_char_at(str, str_len, offset) == '*')) {
 						post_count++;
 						offset++;
 					}
@@ -987,17 +1383,17 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 				// Look left and skip over neighboring '_' characters
 				offset = t->start;
 				
-				while ((offset != 0) && ((str[offset] == '_') || (str[offset] == '*'))) {
+				while ((offset != 0) && ((mmd_char_at(str, str_len, offset) == '_') || (mmd_char_at(str, str_len, offset) == '*'))) {
 					offset--;
 				}
 				
-				if ((offset == 0) || (char_is_whitespace_or_line_ending_or_punctuation(str[offset]))) {
+				if ((offset == 0) || (char_is_whitespace_or_line_ending_or_punctuation(mmd_char_at(str, str_len, offset)))) {
 					// Whitespace or punctuation to left, so can't close
 					t->can_close = 0;
 				}
 
 				// We don't allow intraword underscores (e.g.  `foo_bar_foo`)
-				if ((offset > 0) && (char_is_alphanumeric(str[offset]))) {
+				if ((offset > 0) && (char_is_alphanumeric(mmd_char_at(str, str_len, offset)))) {
 					// Letters to left, so can't open
 					t->can_open = 0;
 				}
@@ -1005,15 +1401,15 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 				// Look right and skip over neighboring '_' characters
 				offset = t->start + 1;
 				
-				while ((str[offset] == '*') || (str[offset] == '_'))
+				while ((mmd_char_at(str, str_len, offset) == '*') || (mmd_char_at(str, str_len, offset) == '_'))
 					offset++;
 				
-				if (char_is_whitespace_or_line_ending_or_punctuation(str[offset])) {
+				if (char_is_whitespace_or_line_ending_or_punctuation(mmd_char_at(str, str_len, offset))) {
 					// Whitespace to right, so can't open
 					t->can_open = 0;
 				}
 				
-				if (char_is_alphanumeric(str[offset])) {
+				if (char_is_alphanumeric(mmd_char_at(str, str_len, offset))) {
 					// Letters to right, so can't close
 					t->can_close = 0;
 				}
@@ -1029,7 +1425,7 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 				if (t->len != 2)
 					break;
 				
-				if ((offset == 0) || (str[offset] != '`' && char_is_whitespace_or_line_ending_or_punctuation(str[offset - 1]))) {
+				if ((offset == 0) || (mmd_char_at(str, str_len, offset) != '`' && char_is_whitespace_or_line_ending_or_punctuation(mmd_char_at(str, str_len, offset - 1)))) {
 					// Whitespace or punctuation to left, so can't close
 					t->can_close = 0;
 				}
@@ -1040,14 +1436,14 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 				// Some of these are actually APOSTROPHE's and should not be paired
 				offset = t->start;
 
-				if (!((offset == 0) || (char_is_whitespace_or_line_ending_or_punctuation(str[offset - 1])) ||
-					(char_is_whitespace_or_line_ending_or_punctuation(str[offset + 1])))) {
+				if (!((offset == 0) || (char_is_whitespace_or_line_ending_or_punctuation(mmd_char_at(str, str_len, offset - 1))) ||
+					(char_is_whitespace_or_line_ending_or_punctuation(mmd_char_at(str, str_len, offset + 1))))) {
 					t->type = APOSTROPHE;
 					break;
 				}
 
-				if (offset && (char_is_punctuation(str[offset - 1])) &&
-					(char_is_alphanumeric(str[offset + 1]))) {
+				if (offset && (char_is_punctuation(mmd_char_at(str, str_len, offset - 1))) &&
+					(char_is_alphanumeric(mmd_char_at(str, str_len, offset + 1)))) {
 					t->type = APOSTROPHE;
 					break;
 				}
@@ -1056,11 +1452,11 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 					break;
 				offset = t->start;
 
-				if ((offset == 0) || (char_is_whitespace_or_line_ending(str[offset - 1]))) {
+				if ((offset == 0) || (char_is_whitespace_or_line_ending(mmd_char_at(str, str_len, offset - 1)))) {
 					t->can_close = 0;
 				}
 
-				if (char_is_whitespace_or_line_ending(str[offset + 1])) {
+				if (char_is_whitespace_or_line_ending(mmd_char_at(str, str_len, offset + 1))) {
 					t->can_open = 0;
 				}
 
@@ -1073,8 +1469,8 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 				offset = t->start;
 				if (t->len == 1) {
 					// Check whether we have '1-2'
-					if ((offset == 0) || (!char_is_digit(str[offset - 1])) ||
-						(!char_is_digit(str[offset + 1]))) {
+					if ((offset == 0) || (!char_is_digit(mmd_char_at(str, str_len, offset - 1))) ||
+						(!char_is_digit(mmd_char_at(str, str_len, offset + 1)))) {
 						t->type = TEXT_PLAIN;
 					}
 				}
@@ -1087,10 +1483,10 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 				offset = t->start;
 
 				// Look left
-				if ((offset == 0) || (char_is_whitespace_or_line_ending(str[offset - 1]))) {
+				if ((offset == 0) || (char_is_whitespace_or_line_ending(mmd_char_at(str, str_len, offset - 1)))) {
 					// Whitespace to left, so can't close
 					t->can_close = 0;
-				} else if ((offset != 0) && (!char_is_whitespace_or_line_ending_or_punctuation(str[offset - 1]))){
+				} else if ((offset != 0) && (!char_is_whitespace_or_line_ending_or_punctuation(mmd_char_at(str, str_len, offset - 1)))){
 					// No whitespace or punctuation to left, can't open
 					t->can_open = 0;
 				}
@@ -1098,10 +1494,10 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 				// Look right
 				offset = t->start + t->len;
 				
-				if (char_is_whitespace_or_line_ending(str[offset])) {
+				if (char_is_whitespace_or_line_ending(mmd_char_at(str, str_len, offset))) {
 					// Whitespace to right, so can't open
 					t->can_open = 0;
-				} else if (!char_is_whitespace_or_line_ending_or_punctuation(str[offset])) {
+				} else if (!char_is_whitespace_or_line_ending_or_punctuation(mmd_char_at(str, str_len, offset))) {
 					// No whitespace or punctuation to right, can't close
 					t->can_close = 0;
 				}
@@ -1114,17 +1510,17 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 				offset = t->start;
 
 				// Look left -- no whitespace to left
-				if ((offset == 0) || (char_is_whitespace_or_line_ending_or_punctuation(str[offset - 1]))) {
+				if ((offset == 0) || (char_is_whitespace_or_line_ending_or_punctuation(mmd_char_at(str, str_len, offset - 1)))) {
 					t->can_open = 0;
 				}
 
-				if ((offset != 0) && (char_is_whitespace_or_line_ending(str[offset - 1]))) {
+				if ((offset != 0) && (char_is_whitespace_or_line_ending(mmd_char_at(str, str_len, offset - 1)))) {
 					t->can_close = 0;
 				}
 
 				offset = t->start + t->len;
 
-				if (char_is_whitespace_or_line_ending_or_punctuation(str[offset])) {
+				if (char_is_whitespace_or_line_ending_or_punctuation(mmd_char_at(str, str_len, offset))) {
 					t->can_open = 0;
 				}
 
@@ -1133,8 +1529,8 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 					offset = t->start + t->len;
 					t->can_open = 0;
 
-					while (!(char_is_whitespace_or_line_ending(str[offset]))) {
-						if (str[offset] == str[t->start])
+					while (!(char_is_whitespace_or_line_ending(mmd_char_at(str, str_len, offset)))) {
+						if (mmd_char_at(str, str_len, offset) == mmd_char_at(str, str_len, t->start))
 							t->can_open = 1;
 						offset++;
 					}
@@ -1142,7 +1538,7 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 					// Are we a standalone, e.g x^2
 					if (!t->can_open) {
 						offset = t->start + t->len;
-						while (!char_is_whitespace_or_line_ending_or_punctuation(str[offset]))
+						while (!char_is_whitespace_or_line_ending_or_punctuation(mmd_char_at(str, str_len, offset)))
 							offset++;
 
 						t->len = offset-t->start;
@@ -1163,18 +1559,31 @@ void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, cons
 					offset = t->start;
 					t->can_close = 0;
 
-					while ((offset > 0) && !(char_is_whitespace_or_line_ending(str[offset - 1]))) {
-						if (str[offset - 1] == str[t->start])
+					while ((offset > 0) && !(char_is_whitespace_or_line_ending(mmd_char_at(str, str_len, offset - 1)))) {
+						if (mmd_char_at(str, str_len, offset - 1) == mmd_char_at(str, str_len, t->start))
 							t->can_close = 1;
 						offset--;
 					}
 				}
 				break;
 		}
+
+		if (t == last)
+			break;
 		
 		t = t->next;
 	}
 
+	return true;
+}
+
+
+/// Assign ambidextrous tokens inside a block
+void mmd_assign_ambidextrous_tokens_in_block(mmd_engine * e, token * block, const char * str, size_t start_offset) {
+	if (block == NULL || block->child == NULL)
+		return;
+
+	mmd_assign_ambidextrous_tokens_in_chain(e, block->child, NULL, str, start_offset);
 }
 
 
@@ -1227,6 +1636,48 @@ void pair_emphasis_tokens(token * t) {
 }
 
 
+/// Blocks nested deeper than kMaxParseDepth are not parsed any further (each
+/// level recurses and needs its own parser).  Instead, the remaining lines are
+/// kept as plain text in a single paragraph.
+static void mmd_flatten_nested_block(mmd_engine * e, token * block) {
+	if (block->child == NULL)
+		return;
+
+	token * line = block->child;
+
+	while (line) {
+		line->type = LINE_PLAIN;
+
+		// Markers that would have started another level are printed as text
+		if (line->child) {
+			switch (line->child->type) {
+				case MARKER_BLOCKQUOTE:
+					line->child->type = ANGLE_RIGHT;
+					break;
+				case MARKER_H1:
+				case MARKER_H2:
+				case MARKER_H3:
+				case MARKER_H4:
+				case MARKER_H5:
+				case MARKER_H6:
+				case MARKER_LIST_BULLET:
+				case MARKER_LIST_ENUMERATOR:
+					line->child->type = TEXT_PLAIN;
+					break;
+			}
+		}
+
+		line = line->next;
+	}
+
+	token * para = token_new_parent(block->child, BLOCK_PARA);
+	block->child = NULL;
+	token_append_child(block, para);
+
+	strip_line_tokens_from_block(e, para);
+}
+
+
 void recursive_parse_list_item(mmd_engine * e, token * block) {
 	// Strip list marker from first line
 	token_remove_first_child(block->child);
@@ -1237,7 +1688,10 @@ void recursive_parse_list_item(mmd_engine * e, token * block) {
 	// Remove one indent level from all lines to allow recursive parsing
 	deindent_block(e, block);
 
-	mmd_parse_token_chain(e, block);
+	if (e->parser_depth >= kMaxParseDepth)
+		mmd_flatten_nested_block(e, block);
+	else
+		mmd_parse_token_chain(e, block);
 }
 
 
@@ -1296,7 +1750,10 @@ void recursive_parse_blockquote(mmd_engine * e, token * block) {
 	// Strip blockquote markers (if present)
 	strip_quote_markers_from_block(e, block);
 
-	mmd_parse_token_chain(e, block);
+	if (e->parser_depth >= kMaxParseDepth)
+		mmd_flatten_nested_block(e, block);
+	else
+		mmd_parse_token_chain(e, block);
 }
 
 
@@ -1367,7 +1824,7 @@ void strip_line_tokens_from_block(mmd_engine * e, token * block) {
 		return;
 
 #ifndef NDEBUG
-	fprintf(stderr, "Strip line tokens from %d (%lu:%lu) (child %d)\n", block->type, block->start, block->len, block->child->type);
+	fprintf(stderr, "Strip line tokens from %d (%lu:%lu) (child %d)\n", block->type, (unsigned long) block->start, (unsigned long) block->len, block->child->type);
 	token_tree_describe(block, NULL);
 #endif
 
@@ -1460,45 +1917,404 @@ void strip_line_tokens_from_block(mmd_engine * e, token * block) {
 }
 
 
+/// Find the inline structure of each top level block (ambidextrous tokens,
+/// matched pairs, and strong/emph), finishing one block before moving on to
+/// the next so that its tokens are still in cache for each step.
+///
+/// Steps are skipped for blocks whose lines have none of the tokens they
+/// look for.  If `nested_meta` is true, metadata may have been found inside
+/// other blocks, so ambidextrous tokens are always checked.
+static void mmd_parse_inline_tokens(mmd_engine * e, token * doc, const char * str, bool nested_meta) {
+	// Prepare stack and token store to be used for token pairing
+	// This avoids allocating/freeing one for each iteration.
+	stack * pair_stack = stack_new(0);
+	token_store * pair_store = token_store_new(0);
+
+	unsigned short need1 = e->pairing_categories[0];
+	unsigned short need2 = e->pairing_categories[1];
+	unsigned short need3 = e->pairing_categories[2];
+
+	size_t line = 0;
+	size_t limit;
+	unsigned short mask;
+
+	for (token * block = doc->child; block != NULL; block = block->next) {
+		// Combine the lines between this block and the next one
+		limit = (block->next) ? block->next->start : SIZE_MAX;
+		mask = 0;
+
+		if (limit > block->start) {
+			while ((line < e->line_count) && (e->line_masks[line].start < limit))
+				mask |= e->line_masks[line++].mask;
+		} else {
+			// Blocks out of order, so check everything
+			mask = INLINE_ALL;
+		}
+
+		// Metadata prevents assigning ambidextrous tokens in the rest of the document
+		if (e->assign_ambidextrous && (nested_meta || (block->type == BLOCK_META) || (mask & kInlineAmbidextrous)))
+			e->assign_ambidextrous = mmd_assign_ambidextrous_tokens_in_chain(e, block, block, str, 0);
+
+		if (mask & need1)
+			mmd_pair_tokens_in_block(block, e->pairings1, pair_stack, pair_store);
+
+		if (mask & need2)
+			mmd_pair_tokens_in_block(block, e->pairings2, pair_stack, pair_store);
+
+		if (mask & need3)
+			mmd_pair_tokens_in_block(block, e->pairings3, pair_stack, pair_store);
+
+		// Top level blocks are never paired themselves, only their contents
+		if (mask & INLINE_EMPH)
+			pair_emphasis_tokens(block->child);
+	}
+
+	// Free stack and token store
+	stack_free(pair_stack);
+	token_store_free(pair_store);
+}
+
+
+/// Parse a token chain from the tokenizer into blocks and pairs, where token
+/// offsets are relative to `byte_start` in the engine's string
+static void mmd_engine_parse_tokens(mmd_engine * e, token * doc, size_t byte_start) {
+	// Nested blocks can only be metadata if no blank line has been seen
+	bool nested_meta = e->allow_meta;
+
+	// Parse tokens into blocks
+	mmd_parse_token_chain(e, doc);
+
+	if (doc) {
+		// Parse blocks for pairs
+		mmd_parse_inline_tokens(e, doc, &e->dstr->str[byte_start], nested_meta);
+
+#ifndef NDEBUG
+		token_tree_describe(doc, &e->dstr->str[byte_start]);
+#endif
+	}
+}
+
+
 /// Parse part of the string into a token tree
 token * mmd_engine_parse_substring(mmd_engine * e, size_t byte_start, size_t byte_len) {
+	if (byte_len > kMaxTokenOffset) {
+		fprintf(stderr, "Source text is too long to parse (%lu bytes)\n", (unsigned long) byte_len);
+		return NULL;
+	}
+
 #ifdef kUseObjectPool
-	// Ensure token pool is available and ready
-	token_pool_init();
+	// Allocate tokens from this engine's arena
+	pool * previous_pool = token_pool_use(e->token_pool);
 #endif
 
 	// Reset definition stack
 	e->definition_stack->size = 0;
+	e->assign_ambidextrous = true;
 	
 	// Tokenize the string
 	token * doc = mmd_tokenize_string(e, &e->dstr->str[byte_start], byte_len);
 
-	// Parse tokens into blocks
-	mmd_parse_token_chain(e, doc);
+	mmd_engine_parse_tokens(e, doc, byte_start);
 
-	if (doc) {
-		// Parse blocks for pairs
-		mmd_assign_ambidextrous_tokens_in_block(e, doc, &e->dstr->str[byte_start], 0);
+#ifdef kUseObjectPool
+	token_pool_use(previous_pool);
+#endif
 
-		// Prepare stack to be used for token pairing
-		// This avoids allocating/freeing one for each iteration.
-		stack * pair_stack = stack_new(0);
+	return doc;
+}
 
-		mmd_pair_tokens_in_block(doc, e->pairings1, pair_stack);
-		mmd_pair_tokens_in_block(doc, e->pairings2, pair_stack);
-		mmd_pair_tokens_in_block(doc, e->pairings3, pair_stack);
 
-		// Free stack
-		stack_free(pair_stack);
+/// Offset just past the line ending of the line containing `offset` (or the
+/// end of the string)
+static size_t mmd_line_end(const char * str, size_t len, size_t offset) {
+	while (offset < len) {
+		switch (str[offset++]) {
+			case '\r':
+				if ((offset < len) && (str[offset] == '\n'))
+					offset++;
+			case '\n':
+				return offset;
+		}
+	}
 
-		pair_emphasis_tokens(doc);
+	return len;
+}
 
-#ifndef NDEBUG
-		token_tree_describe(doc, &e->dstr->str[byte_start]);
+
+/// Does the line at `offset`, following a blank line, start a new top level
+/// block?  Only blank lines, indented lines (code blocks, and the rest of list
+/// items and notes) and list items can continue the block before a blank
+/// line.  This only looks at the start of the line, and errs on the side of
+/// "no".
+static bool mmd_line_starts_block(const char * str, size_t len, size_t offset) {
+	size_t indent = 0;
+
+	while ((offset < len) && (str[offset] == ' ') && (indent < 4)) {
+		offset++;
+		indent++;
+	}
+
+	if ((offset == len) || (indent == 4))
+		return false;
+
+	switch (str[offset]) {
+		case '*':
+		case '+':
+		case '-':
+			// Bulleted list item?
+			return false;
+		default:
+			// Numbered list item, or whitespace?
+			return !char_is_digit(str[offset]) && ((unsigned char) str[offset] > ' ');
+	}
+}
+
+
+/// Might a line of this type hold definitions, headers, or metadata, either
+/// itself or as part of the blocks it contains?
+static bool mmd_line_might_define(unsigned short line_type) {
+	switch (line_type) {
+		case LINE_ATX_1:
+		case LINE_ATX_2:
+		case LINE_ATX_3:
+		case LINE_ATX_4:
+		case LINE_ATX_5:
+		case LINE_ATX_6:
+		case LINE_BLOCKQUOTE:
+		case LINE_DEF_CITATION:
+		case LINE_DEF_FOOTNOTE:
+		case LINE_DEF_LINK:
+		case LINE_LIST_BULLETED:
+		case LINE_LIST_ENUMERATED:
+		case LINE_META:
+			return true;
+	}
+
+	return false;
+}
+
+
+/// Tokenize the next segment of the string, starting at `*offset`, and move
+/// `*offset` to the start of the following segment.  The segment is parsed
+/// unless `definitions_only` is true and none of its lines might hold
+/// definitions, headers, or metadata.  Returns NULL once the whole string has
+/// been parsed.
+///
+/// Segments end before a line that starts a new top level block after a blank
+/// line (outside of fenced code and HTML blocks), so they parse the same way
+/// by themselves as they do as part of the whole string.  Token offsets are
+/// relative to the start of the string.  Definitions found in the segment are
+/// on the definition stack, and headers are added to the header stack.
+static token * mmd_engine_parse_next_segment(mmd_engine * e, size_t * offset, bool definitions_only) {
+	const char * str = e->dstr->str;
+	size_t len = e->dstr->currentStringLength;
+	size_t start = *offset;
+
+	if (start >= len)
+		return NULL;
+
+	if (len > kMaxTokenOffset) {
+		fprintf(stderr, "Source text is too long to parse (%lu bytes)\n", (unsigned long) len);
+		*offset = len;
+		return NULL;
+	}
+
+#ifdef kUseObjectPool
+	// Allocate tokens from this engine's arena
+	pool * previous_pool = token_pool_use(e->token_pool);
 #endif
+
+	// Reset definition stack
+	e->definition_stack->size = 0;
+
+	if (start == 0) {
+		e->allow_meta = (e->extensions & EXT_COMPATIBILITY) ? false : true;
+		e->assign_ambidextrous = true;
 	}
 
-	return doc;
+	tokenizer tz;
+	mmd_tokenizer_init(e, &tz, start);
+
+	size_t end = start;
+	bool after_blank = false;
+
+	// Metadata and nested blocks in the first segment are tricky, so it is
+	// always parsed
+	bool parse = !definitions_only || (start == 0);
+
+	// Tokenize a line at a time, until one starts the next segment
+	while (end < len) {
+		if (after_blank && (tz.fence_state == FENCE_OUTSIDE) && mmd_line_starts_block(str, len, end))
+			break;
+
+		end = mmd_line_end(str, len, end);
+
+		if ((str[end - 1] != '\n') && (str[end - 1] != '\r'))
+			break;
+
+		mmd_tokenize_range(e, &tz, str, end, false);
+
+		after_blank = (tz.root->child->tail->type == LINE_EMPTY);
+		parse = parse || mmd_line_might_define(tz.root->child->tail->type);
+	}
+
+	if (end < len) {
+		// Discard the (empty) line that was started for the next segment
+		token_tree_free(tz.line);
+		token_tree_free(tz.spares);
+	} else {
+		// Tokenize whatever is left, which may end without a newline
+		mmd_tokenize_range(e, &tz, str, len, true);
+		end = len;
+
+		parse = parse || mmd_line_might_define(tz.root->child->tail->type);
+	}
+
+	if (parse)
+		mmd_engine_parse_tokens(e, tz.root, 0);
+
+#ifdef kUseObjectPool
+	token_pool_use(previous_pool);
+#endif
+
+	*offset = end;
+
+	return tz.root;
+}
+
+
+/// Parse the next top level segment of the string
+token * mmd_engine_parse_segment(mmd_engine * e, size_t * offset) {
+	return mmd_engine_parse_next_segment(e, offset, false);
+}
+
+
+/// Parse the next top level segment of the string, if it might hold
+/// definitions, headers, or metadata
+token * mmd_engine_scan_segment(mmd_engine * e, size_t * offset) {
+	return mmd_engine_parse_next_segment(e, offset, true);
+}
+
+
+/// Progress through streamed text, deciding how much of it can be tokenized
+/// before the rest arrives
+typedef struct {
+	size_t			next;				//!< Next character to check
+	size_t			line;				//!< Start of the line being checked
+	size_t			complete;			//!< End of the last complete line
+	size_t			html_line;			//!< Start of a possible multi-line HTML block, or SIZE_MAX
+	bool			blank;				//!< Is the current line blank so far?
+} stream_lines;
+
+
+/// Check streamed text up to `end`, and return how far it can be tokenized.
+/// This is the end of the last complete line (a trailing '\r' might be the
+/// first half of "\r\n"), unless a line since the last blank line starts
+/// with '<'.  The attributes of an HTML block can continue onto the following
+/// lines, so its type isn't known until a blank line arrives.
+static size_t mmd_stream_lines_check(stream_lines * l, const char * str, size_t end) {
+	char c;
+
+	while (l->next < end) {
+		c = str[l->next];
+
+		if (c == '\n' || c == '\r') {
+			if (c == '\r') {
+				if (l->next + 1 == end)
+					break;
+
+				if (str[l->next + 1] == '\n')
+					l->next++;
+			}
+
+			if (l->blank)
+				l->html_line = SIZE_MAX;
+
+			l->complete = ++l->next;
+			l->line = l->next;
+			l->blank = true;
+		} else {
+			if ((c == '<') && (l->next == l->line) && (l->html_line == SIZE_MAX))
+				l->html_line = l->line;
+
+			if (c != ' ' && c != '\t')
+				l->blank = false;
+
+			l->next++;
+		}
+	}
+
+	return (l->html_line < l->complete) ? l->html_line : l->complete;
+}
+
+
+/// Read source text through a callback, appending it to the engine's string,
+/// and parse the entire string into a token tree.  Complete lines are
+/// tokenized as they arrive, rather than waiting for the end of input.
+void mmd_engine_parse_stream(mmd_engine * e, mmd_read_callback read, void * context) {
+	char chunk[kStreamChunkSize];
+	size_t bytes;
+	size_t end;
+
+	// Free existing parse tree
+	if (e->root) {
+		token_tree_free(e->root);
+		e->root = NULL;
+	}
+
+#ifdef kUseObjectPool
+	// Allocate tokens from this engine's arena
+	pool * previous_pool = token_pool_use(e->token_pool);
+#endif
+
+	// Reset definition stack
+	e->definition_stack->size = 0;
+	e->assign_ambidextrous = true;
+
+	tokenizer tz;
+	mmd_tokenizer_init(e, &tz, 0);
+
+	stream_lines lines = { 0, 0, 0, SIZE_MAX, true };
+
+	// Text already in the engine's string is parsed first
+	bytes = e->dstr->currentStringLength;
+
+	do {
+		if (e->dstr->currentStringLength > kMaxTokenOffset) {
+			fprintf(stderr, "Source text is too long to parse (%lu bytes)\n", (unsigned long) e->dstr->currentStringLength);
+
+			token_tree_free(tz.root);
+			token_tree_free(tz.line);
+			token_tree_free(tz.spares);
+
+#ifdef kUseObjectPool
+			token_pool_use(previous_pool);
+#endif
+			return;
+		}
+
+		// Tokenize complete lines -- the string may move as it grows, so
+		// offsets are tracked rather than pointers
+		end = mmd_stream_lines_check(&lines, e->dstr->str, e->dstr->currentStringLength);
+
+		if (end > tz.last_stop)
+			mmd_tokenize_range(e, &tz, e->dstr->str, end, false);
+
+		bytes = read(context, chunk, kStreamChunkSize);
+
+		d_string_append_c_array(e->dstr, chunk, bytes);
+	} while (bytes > 0);
+
+	// Tokenize whatever is left, which may end without a newline
+	mmd_tokenize_range(e, &tz, e->dstr->str, e->dstr->currentStringLength, true);
+
+	mmd_engine_parse_tokens(e, tz.root, 0);
+
+#ifdef kUseObjectPool
+	token_pool_use(previous_pool);
+#endif
+
+	e->root = tz.root;
 }
 
 
@@ -58,20 +58,31 @@
 
 #include "d_string.h"
 #include "libMultiMarkdown.h"
+#include "object_pool.h"
 #include "stack.h"
 #include "token.h"
 #include "token_pairs.h"
 
+/// Kinds of inline tokens found on one line of source text
+typedef struct {
+	size_t					start;				//!< Offset of the line in the source string
+	unsigned short			mask;				//!< Bit mask of inline token categories
+} line_mask;
+
+
 struct mmd_engine {
 	DString *				dstr;
+	bool					borrowed_source;	//!< `dstr` wraps a caller-owned buffer
 	token *					root;
 	unsigned long			extensions;
 
 	bool					allow_meta;
+	bool					assign_ambidextrous;	//!< Cleared by metadata for the rest of the document
 
-	token_pair_engine *		pairings1;
-	token_pair_engine *		pairings2;
-	token_pair_engine *		pairings3;
+	const token_pair_engine *	pairings1;
+	const token_pair_engine *	pairings2;
+	const token_pair_engine *	pairings3;
+	unsigned short			pairing_categories[3];	//!< Inline token categories that each one looks for
 
 	stack *					citation_stack;
 	stack *					definition_stack;
@@ -80,6 +91,17 @@ struct mmd_engine {
 	stack *					link_stack;
 	stack *					metadata_stack;
 
+	stack *					parser_stack;		//!< lemon parsers, one per nesting depth
+	size_t					parser_depth;		//!< Number of parsers in use
+
+	line_mask *				line_masks;			//!< Inline token categories on each tokenized line
+	size_t					line_count;			//!< Number of lines in `line_masks`
+	size_t					line_capacity;		//!< Capacity of `line_masks`
+
+#ifdef kUseObjectPool
+	pool *					token_pool;
+#endif
+
 	short					language;
 	short					quotes_lang;
 };
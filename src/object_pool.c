@@ -58,21 +58,38 @@
 
 #include "object_pool.h"
 
+#ifdef TEST
+#include "CuTest.h"
+#endif
+
 #define kNumberOfObjects	1024
+#define kMinimumSlabs		1		//!< Always keep at least this many slabs after reset
 
 
+/// Make another slab available for allocation, reusing a slab that was
+/// kept by `pool_reset()` if possible
 void pool_add_slab(pool * p) {
-	void * slab = malloc(p->object_size * kNumberOfObjects);
+	void * slab;
 
-	if (slab) {
-		stack_push(p->allocated, slab);
+	if (p->slabs_used < p->allocated->size) {
+		// Recycle existing slab
+		slab = stack_peek_index(p->allocated, p->slabs_used);
+	} else {
+		slab = malloc(p->object_size * kNumberOfObjects);
 
-		// Next object will come from beginning of this slab
-		p->next = slab;
+		if (slab == NULL)
+			return;
 
-		// Set warning to trigger need for next slab
-		p->last = slab + (p->object_size * (kNumberOfObjects));
+		stack_push(p->allocated, slab);
 	}
+
+	p->slabs_used++;
+
+	// Next object will come from beginning of this slab
+	p->next = slab;
+
+	// Set warning to trigger need for next slab
+	p->last = slab + (p->object_size * (kNumberOfObjects));
 }
 
 
@@ -85,6 +102,9 @@ pool * pool_new(short size) {
 
 		p->allocated = stack_new(1024);
 
+		p->slabs_used = 0;
+		p->high_water = 0;
+
 		pool_add_slab(p);
 	}
 
@@ -118,6 +138,49 @@ void pool_drain(pool * p) {
 
 	p->next = NULL;
 	p->last = NULL;
+
+	p->slabs_used = 0;
+	p->high_water = 0;
+}
+
+
+/// Free slabs that are not currently in use, keeping at most `max_slabs`
+void pool_trim(pool * p, size_t max_slabs) {
+	if (p == NULL)
+		return;
+
+	if (max_slabs < p->slabs_used)
+		max_slabs = p->slabs_used;
+
+	while (p->allocated->size > max_slabs) {
+		free(stack_pop(p->allocated));
+	}
+}
+
+
+/// Reset pool -- keep slabs previously allocated for reuse
+void pool_reset(pool * p) {
+	if (p == NULL)
+		return;
+
+	// Keep enough slabs for what was just used, but let the high-water
+	// mark decay so that a single large parse does not pin its memory
+	// forever.
+	p->high_water /= 2;
+
+	if (p->slabs_used > p->high_water)
+		p->high_water = p->slabs_used;
+
+	p->slabs_used = 0;
+
+	if (p->high_water < kMinimumSlabs)
+		p->high_water = kMinimumSlabs;
+
+	pool_trim(p, p->high_water);
+
+	// Next allocation will start over at first slab
+	p->next = NULL;
+	p->last = NULL;
 }
 
 
@@ -138,3 +201,28 @@ void * pool_allocate_object(pool * p) {
 	return a;
 }
 
+
+#ifdef TEST
+void Test_pool_reset(CuTest* tc) {
+	pool * p = pool_new(sizeof(size_t));
+
+	// Use three slabs
+	for (int i = 0; i < kNumberOfObjects * 3; ++i)
+		pool_allocate_object(p);
+
+	CuAssertIntEquals(tc, 3, p->allocated->size);
+
+	void * first = stack_peek_index(p->allocated, 0);
+
+	// Slabs are kept and recycled
+	pool_reset(p);
+	CuAssertIntEquals(tc, 3, p->allocated->size);
+	CuAssertPtrEquals(tc, first, pool_allocate_object(p));
+
+	// High-water mark decays after smaller parses
+	pool_reset(p);
+	CuAssertIntEquals(tc, 1, p->allocated->size);
+
+	pool_free(p);
+}
+#endif
@@ -66,6 +66,8 @@ struct pool {
 	stack *			allocated;		//!< Stack of pointers to slabs that have been allocated
 	void *			next;			//!< Pointer to next available memory for allocation
 	void *			last;			//!< Pointer to end of available memory
+	size_t			slabs_used;		//!< Number of allocated slabs in use since last reset
+	size_t			high_water;		//!< Number of slabs to keep when pool is reset
 	short			object_size;	//!< Size of individual objects to be allocated
 
 	char 			_PADDING[6];	//!< pad struct for alignment
@@ -92,6 +94,22 @@ void pool_drain(
 );
 
 
+/// Reset pool -- keep slabs previously allocated for reuse.  Any objects
+/// previously allocated from the pool are invalidated.  Slabs beyond the
+/// high-water mark are freed, so that one unusually large parse does not
+/// pin its peak memory.
+void pool_reset(
+	pool * p						//!< Pool to be reset
+);
+
+
+/// Free slabs that are not currently in use, keeping at most `max_slabs`
+void pool_trim(
+	pool * p,						//!< Pool to be trimmed
+	size_t max_slabs				//!< Number of slabs to keep
+);
+
+
 /// Request memory for a new object from the pool
 void * pool_allocate_object(
 	pool * p						//!< Pool to be used for allocation
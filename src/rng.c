@@ -18,12 +18,18 @@
 /************ see the book for explanations and caveats! *******************/
 /************ in particular, you need two's complement arithmetic **********/
 
+#include <stddef.h>
+
+#include "thread_local.h"
+
 #define KK 100                     /* the long lag */
 #define LL  37                     /* the short lag */
 #define MM (1L<<30)                 /* the modulus */
 #define mod_diff(x,y) (((x)-(y))&(MM-1)) /* subtraction mod MM */
 
-long ran_x[KK];                    /* the generator state */
+/* Generator state is kept for each thread, so that documents can be
+   processed on several threads at once */
+kThreadLocal long ran_x[KK];       /* the generator state */
 
 #ifdef __STDC__
 void ran_array(long aa[],int n)
@@ -44,9 +50,9 @@ void ran_array(aa,n)    /* put n new random numbers in aa */
 /* after calling ran_start, get new randoms by, e.g., "x=ran_arr_next()" */
 
 #define QUALITY 1009 /* recommended quality level for high-res use */
-long ran_arr_buf[QUALITY];
-long ran_arr_dummy=-1, ran_arr_started=-1;
-long *ran_arr_ptr=&ran_arr_dummy; /* the next random number, or -1 */
+kThreadLocal long ran_arr_buf[QUALITY];
+kThreadLocal long ran_arr_dummy=-1, ran_arr_started=-1;
+kThreadLocal long *ran_arr_ptr=NULL; /* the next random number, or -1 (NULL until first use) */
 
 #define TT  70   /* guaranteed separation between streams */
 #define is_odd(x)  ((x)&1)          /* units bit of x */
@@ -110,8 +116,40 @@ int main()
   return 0;
 } */
 
+kThreadLocal unsigned long ran_num_count = 0;	/* numbers drawn since the last restart */
+
 long ran_num_next()
 {
+	if (ran_arr_ptr == NULL)
+		ran_arr_ptr = &ran_arr_dummy;	/* Can't be set statically for thread-local storage */
+
+	ran_num_count++;
+
 	return ran_arr_next();
 }
 
+/* Start over with the default seed on next use, so that each document's
+   output doesn't depend on the documents exported before it */
+void ran_num_restart()
+{
+	ran_arr_ptr = NULL;
+	ran_num_count = 0;
+}
+
+/* How many numbers have been drawn since the last restart */
+unsigned long ran_num_position()
+{
+	return ran_num_count;
+}
+
+/* Go back (or ahead) to a position from ran_num_position(), so that the
+   same numbers are drawn again */
+void ran_num_seek(unsigned long position)
+{
+	if (position < ran_num_count)
+		ran_num_restart();
+
+	while (ran_num_count < position)
+		ran_num_next();
+}
+
@@ -68,65 +68,160 @@
 //!< performance.
 
 #include "object_pool.h"
+#include "thread_local.h"
 
-static pool * token_pool = NULL;
+/// Default pool for tokens created outside of an mmd_engine
+static kThreadLocal pool * token_pool_default = NULL;
 
-/// Intialize object pool for token allocation
+/// Arena currently used for allocating tokens on this thread
+static kThreadLocal pool * token_pool = NULL;
+
+/// Most recently released arena, kept so that its slabs can be recycled
+static kThreadLocal pool * token_pool_spare = NULL;
+
+
+/// Create a new token arena
+pool * token_pool_new(void) {
+	pool * p = token_pool_spare;
+
+	if (p) {
+		// Recycle slabs from an arena that was already released
+		token_pool_spare = NULL;
+		return p;
+	}
+
+	return pool_new(sizeof(token));
+}
+
+
+/// Free a token arena and all tokens allocated from it.  The
+/// slabs are kept for the next arena created on this thread
+/// (e.g. for the next document when batch processing files).
+void token_pool_release(pool * p) {
+	if (p == NULL)
+		return;
+
+	if (token_pool == p)
+		token_pool = NULL;
+
+	if (token_pool_default == p)
+		token_pool_default = NULL;
+
+	if (token_pool_spare == NULL) {
+		pool_reset(p);
+		token_pool_spare = p;
+	} else {
+		pool_free(p);
+	}
+}
+
+
+/// Allocate tokens created on this thread from the specified arena.
+/// Returns the previously used arena.
+pool * token_pool_use(pool * p) {
+	pool * previous = token_pool;
+
+	token_pool = p;
+
+	return previous;
+}
+
+
+/// Intialize default object pool for token allocation
 void token_pool_init(void) {
-	if (token_pool == NULL) {
+	if (token_pool_default == NULL) {
 		// No pool exists
-		token_pool = pool_new(sizeof(token));
+		token_pool_default = token_pool_new();
 	} else {
 		// Pool exists, ensure it's drained
-		// NOTE: This invalidates any tokens currently in use.
+		// NOTE: This invalidates any tokens currently in use from the default pool.
 		token_pool_drain();
 	}
+
+	if (token_pool == NULL)
+		token_pool = token_pool_default;
 }
 
 
-/// Drain token allocator pool to prepare for another parse
+/// Drain default token allocator pool to prepare for another parse
 void token_pool_drain(void) {
-	pool_drain(token_pool);
+	pool_drain(token_pool_default);
 }
 
 
-/// Free token allocator pool
+/// Free default token allocator pool, as well as any spare slabs
+/// kept for recycling
 void token_pool_free(void) {
-	pool_free(token_pool);
-	token_pool = NULL;
+	pool_free(token_pool_default);
+	pool_free(token_pool_spare);
+
+	if (token_pool == token_pool_default)
+		token_pool = NULL;
+
+	token_pool_default = NULL;
+	token_pool_spare = NULL;
 }
 
 #endif
 
 
+/// Reset fields of a freshly allocated (or reused) token
+static void token_init(token * t, unsigned short type, size_t start, size_t len) {
+	t->type = type;
+	t->start = start;
+	t->len = len;
+
+	t->next = NULL;
+	t->prev = NULL;
+	t->child = NULL;
+
+	t->tail = t;
+
+	t->can_open = true;			//!< Default to true -- we assume openers can open and closers can close
+	t->can_close = true;		//!< unless specified otherwise (e.g. for ambidextrous tokens)
+	t->unmatched = true;
+
+	t->mate = NULL;
+}
+
+
 /// Get pointer to a new token
 token * token_new(unsigned short type, size_t start, size_t len) {
 
 
 #ifdef kUseObjectPool
+	if (token_pool == NULL) {
+		// No arena selected, so fall back to default pool for this thread
+		if (token_pool_default == NULL)
+			token_pool_default = token_pool_new();
+
+		token_pool = token_pool_default;
+	}
+
 	token * t = pool_allocate_object(token_pool);
 #else
 	//token * t = calloc(1, sizeof(token));
 	token * t = malloc(sizeof(token));
 #endif
 
-	if (t) {
-		t->type = type;
-		t->start = start;
-		t->len = len;
+	if (t)
+		token_init(t, type, start, len);
+
+	return t;
+}
+
 
-		t->next = NULL;
-		t->prev = NULL;
-		t->child = NULL;
+/// Get pointer to a new token, taking it from a chain of
+/// discarded tokens if one is available
+token * token_new_from_spares(token ** spares, unsigned short type, size_t start, size_t len) {
+	token * t = *spares;
 
-		t->tail = t;
+	if (t == NULL)
+		return token_new(type, start, len);
 
-		t->can_open = true;			//!< Default to true -- we assume openers can open and closers can close
-		t->can_close = true;		//!< unless specified otherwise (e.g. for ambidextrous tokens)
-		t->unmatched = true;
+	*spares = t->next;
 
-		t->mate = NULL;
-	}
+	token_init(t, type, start, len);
 
 	return t;
 }
@@ -154,6 +249,46 @@ token * token_new_parent(token * child, unsigned short type) {
 }
 
 
+/// Copy a token chain, including children
+token * token_chain_copy(token * t) {
+	token * first = NULL;
+	token * copy;
+	token * walker;
+
+	for (walker = t; walker != NULL; walker = walker->next) {
+		copy = token_new(walker->type, walker->start, walker->len);
+
+		if (copy == NULL)
+			break;
+
+		copy->can_open = walker->can_open;
+		copy->can_close = walker->can_close;
+		copy->unmatched = walker->unmatched;
+		copy->child = token_chain_copy(walker->child);
+
+		if (first == NULL)
+			first = copy;
+		else
+			token_chain_append(first, copy);
+	}
+
+	// Pairs are made from tokens in the same chain (see `token_prune_graft()`)
+	for (walker = t, copy = first; copy != NULL; walker = walker->next, copy = copy->next) {
+		if (walker->mate == NULL)
+			continue;
+
+		for (token * w = t, * c = first; c != NULL; w = w->next, c = c->next) {
+			if (w == walker->mate) {
+				copy->mate = c;
+				break;
+			}
+		}
+	}
+
+	return first;
+}
+
+
 /// Add a new token to the end of a token chain.  The new token
 /// may or may not also be the start of a chain
 void token_chain_append(token * chain_start, token * t) {
@@ -368,9 +503,9 @@ void print_token(token * t, unsigned short depth, const char * string) {
 			fprintf(stderr, "\t");
 		}
 		if (string == NULL) {
-			fprintf(stderr, "* (%d) %lu:%lu\n", t->type, t->start, t->len);
+			fprintf(stderr, "* (%d) %lu:%lu\n", t->type, (unsigned long) t->start, (unsigned long) t->len);
 		} else {
-			fprintf(stderr, "* (%d) %lu:%lu\t'%.*s'\n", t->type, t->start, t->len, (int)t->len, &string[t->start]);
+			fprintf(stderr, "* (%d) %lu:%lu\t'%.*s'\n", t->type, (unsigned long) t->start, (unsigned long) t->len, (int)t->len, &string[t->start]);
 		}
 
 		if (t->child != NULL)
@@ -57,6 +57,9 @@
 #ifndef TOKEN_PARSER_TEMPLATE_H
 #define TOKEN_PARSER_TEMPLATE_H
 
+#include <stdint.h>
+#include <stdlib.h>
+
 
 #define kUseObjectPool 1		//!< Use an object pool to allocate tokens to improve
 										//!< performance in memory allocation. Frees all
@@ -64,16 +67,50 @@
 
 
 #ifdef kUseObjectPool
-void token_pool_init(void);				//!< Initialize object pool for allocating tokens
-void token_pool_drain(void);			//!< Drain pool to free memory when parse complete
-void token_pool_free(void);				//!< Free the token object pool
+struct pool;
+
+struct pool * token_pool_new(void);		//!< Create a new token arena (e.g. one per mmd_engine)
+void token_pool_release(struct pool * p);	//!< Free a token arena and all tokens allocated from it (slabs are recycled)
+
+/// Allocate tokens created on the calling thread from the specified arena.
+/// Returns the arena that was previously in use so that it can be restored.
+/// If no arena is specified, the default pool for the thread is used.
+struct pool * token_pool_use(
+	struct pool * p						//!< Arena to use for new tokens (or NULL)
+);
+
+void token_pool_init(void);				//!< Initialize default object pool for allocating tokens on this thread
+void token_pool_drain(void);			//!< Drain default pool to free memory when parse complete
+void token_pool_free(void);				//!< Free the default token object pool and recycled slabs for this thread
 #endif
 
 
+// Build with `kUseCompactTokens` (cmake -DCOMPACT_TOKENS=1) to store token
+// offsets as 32-bit values and pack the flags alongside the type.  This
+// reduces the size of each token, but limits the source string to 4 GB.
+#ifdef kUseCompactTokens
+	#define kMaxTokenOffset		UINT32_MAX	//!< Largest source string that can be parsed
+#else
+	#define kMaxTokenOffset		SIZE_MAX	//!< Largest source string that can be parsed
+#endif
+
+
+#define kMaxTokenTypes	200			// This needs to be larger than the largest token type being used
+
+
 /// Definition for token node struct.  This can be used to match an
 /// abstract syntax tree with the appropriate spans in the original
 /// source string.
 struct token {
+#ifdef kUseCompactTokens
+	unsigned short		type;			//!< Type for the token
+	unsigned short		can_open  : 1;	//!< Can token open a matched pair?
+	unsigned short		can_close : 1;	//!< Can token close a matched pair?
+	unsigned short		unmatched : 1;	//!< Has token been matched yet?
+
+	uint32_t			start;			//!< Starting offset in the source string
+	uint32_t			len;			//!< Length of the token in the source string
+#else
 	unsigned short		type;			//!< Type for the token
 	short				can_open;		//!< Can token open a matched pair?
 	short				can_close;		//!< Can token close a matched pair?
@@ -81,6 +118,7 @@ struct token {
 
 	size_t				start;			//!< Starting offset in the source string
 	size_t				len;			//!< Length of the token in the source string
+#endif
 
 	struct token *		next;			//!< Pointer to next token in the chain
 	struct token *		prev;			//!< Pointer to previous marker in the chain
@@ -101,12 +139,27 @@ token * token_new(
 	size_t len							//!< Len of token
 );
 
+/// Get pointer to a new token, taking it from a chain of
+/// discarded tokens if one is available
+token * token_new_from_spares(
+	token ** spares,					//!< Chain of discarded tokens (updated)
+	unsigned short type,				//!< Type for new token
+	size_t start,						//!< Starting offset for token
+	size_t len							//!< Len of token
+);
+
 /// Create a parent for a chain of tokens
 token * token_new_parent(
 	token * child,						//!< Pointer to child token chain
 	unsigned short type					//!< Type for new token
 );
 
+/// Copy a token chain, including children, into newly allocated tokens.
+/// Matched pairs within each chain point to their copies.
+token * token_chain_copy(
+	token * t							//!< Pointer to start of token chain
+);
+
 /// Add a new token to the end of a token chain.  The new token
 /// may or may not also be the start of a chain
 void token_chain_append(
@@ -61,27 +61,12 @@
 #include "stack.h"
 #include "token.h"
 #include "token_pairs.h"
+#include "token_store.h"
 
 
 /// Create a new token pair engine
 token_pair_engine * token_pair_engine_new(void) {
-	token_pair_engine * e = malloc(sizeof(token_pair_engine));
-
-	if (e) {
-		unsigned short empty[kMaxTokenTypes] = {0};
-		unsigned short empty2[kMaxTokenTypes][kMaxTokenTypes] = {{0}};
-
-		memcpy(e->can_open_pair, empty, sizeof(unsigned short) * kMaxTokenTypes);
-		memcpy(e->can_close_pair, empty, sizeof(unsigned short) * kMaxTokenTypes);
-
-		memcpy(e->pair_type, empty2, sizeof(unsigned short) * kMaxTokenTypes * kMaxTokenTypes);
-
-		memcpy(e->empty_allowed, empty, sizeof(unsigned short) * kMaxTokenTypes);
-		memcpy(e->match_len, empty, sizeof(unsigned short) * kMaxTokenTypes);
-		memcpy(e->should_prune, empty, sizeof(unsigned short) * kMaxTokenTypes);
-	}
-
-	return e;
+	return calloc(1, sizeof(token_pair_engine));
 }
 
 
@@ -94,23 +79,53 @@ void token_pair_engine_free(token_pair_engine * e) {
 }
 
 
+/// Find the slot used by a token type, adding a new one if needed
+static unsigned char token_pair_engine_slot(token_pair_engine * e, unsigned short type) {
+	if (e->slot[type] == 0) {
+		if (e->slot_count + 1 == kMaxPairSlots) {
+			fprintf(stderr, "Too many token types in token pair engine (%d)\n", kMaxPairSlots - 1);
+			e->overflow = 1;
+			return 0;
+		}
+
+		e->slot[type] = ++e->slot_count;
+	}
+
+	return e->slot[type];
+}
+
+
 /// Add a new pairing configuration to a token pair engine
 void token_pair_engine_add_pairing(token_pair_engine * e, unsigned short open_type, unsigned short close_type,
 	unsigned short pair_type, int options) {
-	// \todo: This needs to be more sophisticated
-	e->can_open_pair[open_type] = 1;
-	e->can_close_pair[close_type] = 1;
-	(e->pair_type)[open_type][close_type] = pair_type;
+	unsigned char open = token_pair_engine_slot(e, open_type);
+	unsigned char close = token_pair_engine_slot(e, close_type);
 
-	if (options & PAIRING_ALLOW_EMPTY)
-		e->empty_allowed[pair_type] = true;
+	if ((open == 0) || (close == 0))
+		return;
 
-	if (options & PAIRING_MATCH_LENGTH)
-		e->match_len[pair_type] = true;
+	// Remember which openers to check for this closer
+	unsigned short i = 0;
 
-	if (options & PAIRING_PRUNE_MATCH)
-		e->should_prune[pair_type] = true;
+	while ((i < e->opener_count[close]) && (e->openers[close][i] != open_type))
+		i++;
+
+	if (i == e->opener_count[close]) {
+		if (i == kMaxOpenersPerCloser) {
+			fprintf(stderr, "Too many opener types for closer %d in token pair engine (%d)\n", close_type, kMaxOpenersPerCloser);
+			e->overflow = 1;
+			return;
+		}
+
+		e->openers[close][i] = open_type;
+		e->opener_count[close]++;
+	}
 
+	e->can_open_pair[open] = 1;
+	e->can_close_pair[close] = 1;
+	e->pair_type[open][close] = pair_type;
+	e->pair_options[open][close] = options;
+	token_type_mask_set(e->opener_mask[close], open_type);
 }
 
 
@@ -127,122 +142,222 @@ void token_pair_mate(token * a, token * b) {
 }
 
 
+/// Add opener to the stack, and to the list of waiting openers of its type
+static void token_pairs_push_opener(stack * s, token_store * ts, size_t index) {
+	unsigned short type = ts->type[index];
+
+	stack_push(s, token_store_token(ts, index));
+
+	ts->opener_below[index] = ts->opener_top[type];
+	ts->opener_top[type] = index;
+	ts->pair_depth[index] = 0;
+
+	token_type_mask_set(ts->opener_live, type);
+}
+
+
+/// Waiting opener at `index`, unless it belongs to a parent token
+/// (e.g. it was loaded before `base`)
+static inline size_t token_pairs_local_opener(size_t index, size_t base) {
+	return ((index != kTokenStoreNoIndex) && (index >= base)) ? index : kTokenStoreNoIndex;
+}
+
+
+/// Remove most recent opener from the stack, and from the list of waiting
+/// openers of its type
+static token * token_pairs_pop_opener(stack * s, token_store * ts, size_t base) {
+	token * t = stack_pop(s);
+
+	ts->opener_top[t->type] = ts->opener_below[ts->opener_top[t->type]];
+
+	if (token_pairs_local_opener(ts->opener_top[t->type], base) == kTokenStoreNoIndex)
+		token_type_mask_clear(ts->opener_live, t->type);
+
+	return t;
+}
+
+
+/// Note that pruned pairs nested `depth` deep were matched after the most
+/// recent opener, unless it belongs to a parent token
+static inline void token_pairs_note_depth(stack * s, token_store * ts, size_t start_counter, unsigned short depth) {
+	if (s->size > start_counter) {
+		token * t = stack_peek(s);
+		size_t index = ts->opener_top[t->type];
+
+		if (ts->pair_depth[index] < depth)
+			ts->pair_depth[index] = depth;
+	}
+}
+
+
+/// Is there a waiting opener that could pair with this closer?
+static inline bool token_pairs_opener_waiting(const token_pair_engine * e, token_store * ts, unsigned char closer) {
+	for (int i = 0; i < kTokenTypeMaskWords; ++i) {
+		if (ts->opener_live[i] & e->opener_mask[closer][i])
+			return true;
+	}
+
+	return false;
+}
+
+
 /// Search a token's childen for matching pairs
-void token_pairs_match_pairs_inside_token(token * parent, token_pair_engine * e, stack * s) {
+void token_pairs_match_pairs_inside_token(token * parent, const token_pair_engine * e, stack * s, token_store * ts) {
+
+	// Load the child chain into the token store, and walk it by index
+	size_t base = token_store_append_chain(ts, parent->child);
+	size_t end = ts->size;
+	size_t index = base;
+	unsigned char flags;
 
-	// Walk the child chain
-	token * walker = parent->child;
+	token * walker;
 
-	// Counter
-	size_t start_counter = s->size;
-	size_t i = start_counter;			// We're sharing one stack, so any opener earlier than this belongs to a parent
+	size_t start_counter = s->size;		// We're sharing one stack, so any opener earlier than this belongs to a parent
+
+	uint64_t parent_live[kTokenTypeMaskWords];	// Openers waiting in the parent aren't available here
+	memcpy(parent_live, ts->opener_live, sizeof(parent_live));
+	memset(ts->opener_live, 0, sizeof(parent_live));
 
 	token * peek;
 	unsigned short pair_type;
+	unsigned char pair_options;
+	unsigned short type;
+	unsigned char slot;
 
-	unsigned int opener_count[kMaxTokenTypes] = {0};	// Keep track of which token types are on the stack
+	size_t candidate[kMaxOpenersPerCloser];	// Most recent waiting opener of each type that can pair with closer
+	unsigned short count;
+	unsigned short best;
+	unsigned short j;
+	unsigned short depth;
 
-	while (walker != NULL) {
+	for (; index < end; ++index) {
+		flags = ts->flags[index];
 
-		if (walker->child) {
-			token_pairs_match_pairs_inside_token(walker, e, s);
+		if (flags & TOKEN_STORE_HAS_CHILD) {
+			token_pairs_match_pairs_inside_token(token_store_token(ts, index), e, s, ts);
 		}
 
 		// Is this a closer?
-		if (walker->can_close && e->can_close_pair[walker->type] && walker->unmatched ) {
-			i = s->size;
-
-			// Do we even have a valid opener in the stack?
-			// It's only worth checking if the stack is beyond a certain size
-			if (i > start_counter + kLargeStackThreshold) {
-				for (int j = 0; j < kMaxTokenTypes; ++j)
-				{
-					if (opener_count[j]) {
-						if (e->pair_type[j][walker->type])
-							goto close;
-					}
+		if ((flags & (TOKEN_STORE_CAN_CLOSE | TOKEN_STORE_UNMATCHED)) == (TOKEN_STORE_CAN_CLOSE | TOKEN_STORE_UNMATCHED) &&
+			(slot = e->slot[ts->type[index]]) &&
+			e->can_close_pair[slot] &&
+			token_pairs_opener_waiting(e, ts, slot)) {
+			walker = token_store_token(ts, index);
+			count = e->opener_count[slot];
+
+			for (j = 0; j < count; ++j) {
+				type = e->openers[slot][j];
+				candidate[j] = token_type_mask_has(ts->opener_live, type) ? ts->opener_top[type] : kTokenStoreNoIndex;
+			}
+
+			// Find matching opener for this closer, checking candidates from
+			// the top of the stack down
+			while (1) {
+				best = count;
+
+				for (j = 0; j < count; ++j) {
+					if ((candidate[j] != kTokenStoreNoIndex) &&
+						((best == count) || (candidate[j] > candidate[best])))
+						best = j;
 				}
 
-				// No opener available for this as closer
-				goto open;
-			}
+				if (best == count)
+					break;			// No opener available for this closer
+
+				peek = token_store_token(ts, candidate[best]);
+
+				pair_type = e->pair_type[e->slot[peek->type]][slot];
+				pair_options = e->pair_options[e->slot[peek->type]][slot];
 
-			close:
-			// Find matching opener for this closer
-			while (i > start_counter) {
-				peek = stack_peek_index(s, i - 1);
-
-				pair_type = e->pair_type[peek->type][walker->type];
-
-				if (pair_type) {
-					if (!e->empty_allowed[pair_type]) {
-						// Make sure they aren't consecutive tokens
-						if ((peek->next == walker) &&
-							(peek->start + peek->len == walker->start)) {
-							// i--;
-							i = start_counter;	// In this situation, we can't use this token as a closer
-							continue;
-						}
+				if (!(pair_options & PAIRING_ALLOW_EMPTY)) {
+					// Make sure they aren't consecutive tokens
+					if ((peek->next == walker) &&
+						(peek->start + peek->len == walker->start)) {
+						// In this situation, we can't use this token as a closer
+						break;
 					}
+				}
 
-					if (e->match_len[pair_type]) {
-						// Lengths must match
-						if (peek->len != walker->len) {
-							i--;
-							continue;
-						}
+				if (pair_options & PAIRING_MATCH_LENGTH) {
+					// Lengths must match
+					if (peek->len != walker->len) {
+						candidate[best] = token_pairs_local_opener(ts->opener_below[candidate[best]], base);
+						continue;
 					}
+				}
 
-					token_pair_mate(peek, walker);
+				// Clear portion of stack between opener and closer as they are
+				// now unavailable for mating, and find how deeply the pruned
+				// pairs between them are nested
+				depth = 0;
 
+				do {
+					walker = stack_peek(s);
 
-					// Clear portion of stack between opener and closer as they are now unavailable for mating
-					while (s->size > (i - 1)) {
-						peek = stack_pop(s);
-						opener_count[peek->type]--;
-					}
-#ifndef NDEBUG
-					fprintf(stderr, "stack now sized %lu\n", s->size);
-#endif
-					// Prune matched section
-
-					if (e->should_prune[pair_type]) {
-						if (peek->prev == NULL) {
-							walker = token_prune_graft(peek, walker, e->pair_type[peek->type][walker->type]);
-							parent->child = walker;
-						} else {
-							walker = token_prune_graft(peek, walker, e->pair_type[peek->type][walker->type]);
-						}
+					if (ts->pair_depth[ts->opener_top[walker->type]] > depth)
+						depth = ts->pair_depth[ts->opener_top[walker->type]];
+
+					token_pairs_pop_opener(s, ts, base);
+				} while (walker != peek);
+
+				walker = token_store_token(ts, index);
+
+				if (pair_options & PAIRING_PRUNE_MATCH) {
+					// Pruned pairs are nested child chains that are walked
+					// recursively, so limit how deeply they can be nested
+					if (depth == kMaxPairDepth) {
+						token_pairs_note_depth(s, ts, start_counter, depth);
+						break;
 					}
 
-					break;
+					depth++;
 				}
+
+				token_pair_mate(peek, walker);
+				token_pairs_note_depth(s, ts, start_counter, depth);
+
 #ifndef NDEBUG
-				else {
-					fprintf(stderr, "token type %d failed to match stack element\n", walker->type);
-				}
+				fprintf(stderr, "stack now sized %lu\n", s->size);
 #endif
-				i--;
+				// Prune matched section
+
+				if (pair_options & PAIRING_PRUNE_MATCH) {
+					if (peek->prev == NULL) {
+						walker = token_prune_graft(peek, walker, pair_type);
+						parent->child = walker;
+					} else {
+						walker = token_prune_graft(peek, walker, pair_type);
+					}
+				}
+
+				// Opener and closer are no longer available, and the closer
+				// may have been replaced by the pruned container
+				ts->link[index] = walker;
+				ts->flags[index] = flags = 0;
+				break;
 			}
 		}
 
-		open:
 		// Is this an opener?
-		if (walker->can_open && e->can_open_pair[walker->type] && walker->unmatched) {
-			stack_push(s, walker);
-			opener_count[walker->type]++;
+		if ((flags & (TOKEN_STORE_CAN_OPEN | TOKEN_STORE_UNMATCHED)) == (TOKEN_STORE_CAN_OPEN | TOKEN_STORE_UNMATCHED) &&
+			(slot = e->slot[ts->type[index]]) &&
+			e->can_open_pair[slot]) {
+			token_pairs_push_opener(s, ts, index);
 #ifndef NDEBUG
-		fprintf(stderr, "push token type %d to stack (%lu elements)\n", walker->type, s->size);
+		fprintf(stderr, "push token type %d to stack (%lu elements)\n", ts->type[index], (unsigned long) s->size);
 #endif
 		}
-
-		walker = walker->next;
 	}
 
 #ifndef NDEBUG
 	fprintf(stderr, "token stack has %lu elements (of %lu)\n", s->size, s->capacity);
 #endif
 
-	// Remove unused tokens from stack and return to parent
-	s->size = start_counter;
+	// Remove unused tokens from stack and store, and return to parent
+	while (s->size > start_counter)
+		token_pairs_pop_opener(s, ts, base);
+
+	memcpy(ts->opener_live, parent_live, sizeof(parent_live));
+
+	token_store_truncate(ts, base);
 }
@@ -59,27 +59,38 @@
 
 #include "stack.h"
 #include "token.h"
+#include "token_store.h"
 
 
 #ifdef TEST
 #include "CuTest.h"
 #endif
 
-#define kMaxTokenTypes	200			// This needs to be larger than the largest token type being used
-#define kLargeStackThreshold 1000	// Avoid unnecessary searches of large stacks
+#define kMaxOpenersPerCloser	8	// How many different token types can open a pair with the same closer?
+#define kMaxPairDepth		1000	// How deeply can pruned pairs be nested inside one token?
+#define kMaxPairSlots		32		// How many different token types can one engine use (slot 0 is unused)?
 
 
 /// Store information about which tokens can be paired, and what actions to take when 
 /// pairing them.
+///
+/// Only a few token types take part in pairing, so each one is given a slot,
+/// and the tables are indexed by slot rather than by token type.
 struct token_pair_engine {
-	unsigned short		can_open_pair[kMaxTokenTypes];				//!< Can token type open a pair?
-	unsigned short		can_close_pair[kMaxTokenTypes];				//!< Can token type close a pair?
+	unsigned char		slot[kMaxTokenTypes];							//!< Which slot is used by token type (0 if not used)?
+	unsigned char		slot_count;										//!< How many slots are in use?
 
-	unsigned short		pair_type[kMaxTokenTypes][kMaxTokenTypes];	//!< Which pair are we forming?
+	unsigned char		can_open_pair[kMaxPairSlots];					//!< Can token type open a pair?
+	unsigned char		can_close_pair[kMaxPairSlots];					//!< Can token type close a pair?
 
-	unsigned short		empty_allowed[kMaxTokenTypes];				//!< Is this pair type allowed to be empty?
-	unsigned short		match_len[kMaxTokenTypes];					//!< Does this pair type require matched lengths of openers/closers?
-	unsigned short		should_prune[kMaxTokenTypes];				//!< Does this pair type need to be pruned to a child token chain?
+	unsigned short		pair_type[kMaxPairSlots][kMaxPairSlots];		//!< Which pair are we forming?
+	unsigned char		pair_options[kMaxPairSlots][kMaxPairSlots];		//!< Which options (e.g. `PAIRING_ALLOW_EMPTY`) apply to this pair?
+
+	unsigned short		openers[kMaxPairSlots][kMaxOpenersPerCloser];	//!< Which token types can open a pair with this closer?
+	unsigned char		opener_count[kMaxPairSlots];					//!< How many token types can open a pair with this closer?
+	uint64_t			opener_mask[kMaxPairSlots][kTokenTypeMaskWords];	//!< Bit mask of the token types that can open a pair with this closer
+
+	unsigned char		overflow;										//!< Were any pairings left out because a table was full?
 };
 
 typedef struct token_pair_engine token_pair_engine;
@@ -110,11 +121,22 @@ void token_pair_engine_add_pairing(
 	int options								//!< Token pair options to use
 );
 
+/// Shared pairing tables for each combination of extensions, created at
+/// build time by token_pairs_lookup.c
+extern const token_pair_engine kPairingsNone;				//!< No pairs
+extern const token_pair_engine kPairingsCritic;				//!< CriticMarkup
+extern const token_pair_engine kPairingsBrackets;			//!< Brackets, parentheses, angles, backticks, math
+extern const token_pair_engine kPairingsBracketsCompat;		//!< Brackets, etc. without math (`EXT_COMPATIBILITY`)
+extern const token_pair_engine kPairingsEmphasis;			//!< Strong/emph, quotes, superscript/subscript
+extern const token_pair_engine kPairingsEmphasisCompat;		//!< Strong/emph and quotes (`EXT_COMPATIBILITY`)
+
+
 /// Search a token's childen for matching pairs
 void token_pairs_match_pairs_inside_token(
 	token * parent,							//!< Which tokens should we search for pairs
-	token_pair_engine * e,					//!< Token pair engine to be used for matching
-	stack * s								//!< Pointer to a stack to use for pairing tokens
+	const token_pair_engine * e,			//!< Token pair engine to be used for matching
+	stack * s,								//!< Pointer to a stack to use for pairing tokens
+	token_store * ts						//!< Pointer to a token store to use for walking token chains
 );
 
 
@@ -0,0 +1,234 @@
+/**
+
+	MultiMarkdown 6 -- Lightweight markup processor to produce HTML, LaTeX, and more.
+
+	@file token_pairs_lookup.c
+
+	@brief Create the shared token pair tables used by mmd.c (token_pair_tables.c)
+
+	This is run as part of the build:
+
+		token_pairs_lookup > token_pair_tables.c
+
+
+	@author	Fletcher T. Penney
+	@bug	
+
+**/
+
+/*
+
+	Copyright © 2016 - 2017 Fletcher T. Penney.
+
+
+	The `MultiMarkdown 6` project is released under the MIT License..
+	
+	GLibFacade.c and GLibFacade.h are from the MultiMarkdown v4 project:
+	
+		https://github.com/fletcher/MultiMarkdown-4/
+	
+	MMD 4 is released under both the MIT License and GPL.
+	
+	
+	CuTest is released under the zlib/libpng license. See CuTest.c for the text
+	of the license.
+	
+	
+	## The MIT License ##
+	
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+
+*/
+
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libMultiMarkdown.h"
+#include "token_pairs.h"
+
+
+// Shortcut to add a pairing to an engine
+#define pair(o, c, t, opt)	token_pair_engine_add_pairing(e, o, c, t, opt)
+
+
+/// CriticMarkup
+static void add_critic_pairings(token_pair_engine * e) {
+	pair(CRITIC_ADD_OPEN, CRITIC_ADD_CLOSE, PAIR_CRITIC_ADD, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+	pair(CRITIC_DEL_OPEN, CRITIC_DEL_CLOSE, PAIR_CRITIC_DEL, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+	pair(CRITIC_COM_OPEN, CRITIC_COM_CLOSE, PAIR_CRITIC_COM, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+	pair(CRITIC_SUB_OPEN, CRITIC_SUB_DIV_A, PAIR_CRITIC_SUB_DEL, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+	pair(CRITIC_SUB_DIV_B, CRITIC_SUB_CLOSE, PAIR_CRITIC_SUB_ADD, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+	pair(CRITIC_HI_OPEN, CRITIC_HI_CLOSE, PAIR_CRITIC_HI, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+}
+
+
+/// Brackets, Parentheses, Angles, Backticks, and Math
+static void add_bracket_pairings(token_pair_engine * e, bool compatibility) {
+	pair(BRACKET_LEFT, BRACKET_RIGHT, PAIR_BRACKET, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+	pair(BRACKET_CITATION_LEFT, BRACKET_RIGHT, PAIR_BRACKET_CITATION, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+	pair(BRACKET_FOOTNOTE_LEFT, BRACKET_RIGHT, PAIR_BRACKET_FOOTNOTE, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+	pair(BRACKET_IMAGE_LEFT, BRACKET_RIGHT, PAIR_BRACKET_IMAGE, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+	pair(BRACKET_VARIABLE_LEFT, BRACKET_RIGHT, PAIR_BRACKET_VARIABLE, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+	pair(PAREN_LEFT, PAREN_RIGHT, PAIR_PAREN, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+	pair(ANGLE_LEFT, ANGLE_RIGHT, PAIR_ANGLE, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+	pair(BRACE_DOUBLE_LEFT, BRACE_DOUBLE_RIGHT, PAIR_BRACES, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+
+	pair(BACKTICK, BACKTICK, PAIR_BACKTICK, PAIRING_PRUNE_MATCH | PAIRING_MATCH_LENGTH);
+
+	if (!compatibility) {
+		pair(MATH_PAREN_OPEN, MATH_PAREN_CLOSE, PAIR_MATH, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+		pair(MATH_BRACKET_OPEN, MATH_BRACKET_CLOSE, PAIR_MATH, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+		pair(MATH_DOLLAR_SINGLE, MATH_DOLLAR_SINGLE, PAIR_MATH, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+		pair(MATH_DOLLAR_DOUBLE, MATH_DOLLAR_DOUBLE, PAIR_MATH, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+	}
+}
+
+
+/// Strong/Emph, Quotes, and Superscript/Subscript
+static void add_emphasis_pairings(token_pair_engine * e, bool compatibility) {
+	pair(STAR, STAR, PAIR_STAR, 0);
+	pair(UL, UL, PAIR_UL, 0);
+
+	pair(BACKTICK,   QUOTE_RIGHT_ALT,   PAIR_QUOTE_ALT, PAIRING_ALLOW_EMPTY | PAIRING_MATCH_LENGTH);
+	pair(QUOTE_SINGLE, QUOTE_SINGLE, PAIR_QUOTE_SINGLE, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+	pair(QUOTE_DOUBLE, QUOTE_DOUBLE, PAIR_QUOTE_DOUBLE, PAIRING_ALLOW_EMPTY | PAIRING_PRUNE_MATCH);
+
+	if (!compatibility) {
+		pair(SUPERSCRIPT, SUPERSCRIPT, PAIR_SUPERSCRIPT, 0);
+		pair(SUBSCRIPT, SUBSCRIPT, PAIR_SUPERSCRIPT, 0);
+	}
+}
+
+
+/// Print a row of values, e.g. `{ 0, 1, 2 }`
+static void print_row(const char * indent, const unsigned short * values, int count) {
+	fprintf(stdout, "%s{", indent);
+
+	for (int i = 0; i < count; ++i) {
+		fprintf(stdout, "%s%d", (i) ? ", " : " ", values[i]);
+	}
+
+	fprintf(stdout, " },\n");
+}
+
+
+/// Print the slots that are in use from an array indexed by slot
+#define print_slots(e, field, n) do {									\
+	unsigned short row[kMaxPairSlots];									\
+	for (int k = 0; k < n; ++k) row[k] = (e)->field[k];				\
+	fprintf(stdout, "\t.%s = ", #field);								\
+	print_row("", row, n);												\
+} while (0)
+
+
+/// Print the slots that are in use from a table indexed by slot and slot
+#define print_table(e, field, n, m) do {								\
+	unsigned short row[kMaxPairSlots];									\
+	fprintf(stdout, "\t.%s = {\n", #field);							\
+	for (int i = 0; i < n; ++i) {										\
+		for (int k = 0; k < m; ++k) row[k] = (e)->field[i][k];			\
+		print_row("\t\t", row, m);										\
+	}																	\
+	fprintf(stdout, "\t},\n");											\
+} while (0)
+
+
+/// Print token pair engine as a `const` definition.  Returns 1 if any of its
+/// pairings were left out because a table was full.
+static int print_engine(const char * name, token_pair_engine * e) {
+	int n = e->slot_count + 1;
+	int overflow = e->overflow;
+
+	fprintf(stdout, "const token_pair_engine %s = {\n", name);
+
+	fprintf(stdout, "\t.slot = {\n");
+	fprintf(stdout, "\t\t[0] = 0,\n");
+
+	for (int i = 0; i < kMaxTokenTypes; ++i) {
+		if (e->slot[i])
+			fprintf(stdout, "\t\t[%d] = %d,\n", i, e->slot[i]);
+	}
+
+	fprintf(stdout, "\t},\n");
+	fprintf(stdout, "\t.slot_count = %d,\n", e->slot_count);
+
+	print_slots(e, can_open_pair, n);
+	print_slots(e, can_close_pair, n);
+
+	print_table(e, pair_type, n, n);
+	print_table(e, pair_options, n, n);
+	print_table(e, openers, n, kMaxOpenersPerCloser);
+
+	print_slots(e, opener_count, n);
+
+	fprintf(stdout, "\t.opener_mask = {\n");
+
+	for (int i = 0; i < n; ++i) {
+		fprintf(stdout, "\t\t{");
+
+		for (int k = 0; k < kTokenTypeMaskWords; ++k) {
+			fprintf(stdout, "%s0x%016llxULL", (k) ? ", " : " ", (unsigned long long) e->opener_mask[i][k]);
+		}
+
+		fprintf(stdout, " },\n");
+	}
+
+	fprintf(stdout, "\t},\n");
+	fprintf(stdout, "};\n\n");
+
+	token_pair_engine_free(e);
+
+	return overflow;
+}
+
+
+int main(void) {
+	token_pair_engine * e;
+	int status = 0;
+
+	fprintf(stdout, "// Created by token_pairs_lookup.c -- do not edit, run `make token_pair_tables`\n\n");
+	fprintf(stdout, "#include \"token_pairs.h\"\n\n");
+
+	status |= print_engine("kPairingsNone", token_pair_engine_new());
+
+	e = token_pair_engine_new();
+	add_critic_pairings(e);
+	status |= print_engine("kPairingsCritic", e);
+
+	e = token_pair_engine_new();
+	add_bracket_pairings(e, false);
+	status |= print_engine("kPairingsBrackets", e);
+
+	e = token_pair_engine_new();
+	add_bracket_pairings(e, true);
+	status |= print_engine("kPairingsBracketsCompat", e);
+
+	e = token_pair_engine_new();
+	add_emphasis_pairings(e, false);
+	status |= print_engine("kPairingsEmphasis", e);
+
+	e = token_pair_engine_new();
+	add_emphasis_pairings(e, true);
+	status |= print_engine("kPairingsEmphasisCompat", e);
+
+	// Fail the build rather than compile tables with pairings missing
+	return status;
+}
@@ -0,0 +1,169 @@
+/**
+
+	MultiMarkdown 6 -- Lightweight markup processor to produce HTML, LaTeX, and more.
+
+	@file token_store.c
+
+	@brief Dense "struct of arrays" copy of the fields of a token chain that are
+	read in tight loops (e.g. when matching pairs), so that those loops do not
+	need to pull an entire token into cache for each step.
+
+
+	@author	Fletcher T. Penney
+	@bug	
+
+**/
+
+/*
+
+	Copyright © 2016 - 2017 Fletcher T. Penney.
+
+
+	The `MultiMarkdown 6` project is released under the MIT License..
+	
+	GLibFacade.c and GLibFacade.h are from the MultiMarkdown v4 project:
+	
+		https://github.com/fletcher/MultiMarkdown-4/
+	
+	MMD 4 is released under both the MIT License and GPL.
+	
+	
+	CuTest is released under the zlib/libpng license. See CuTest.c for the text
+	of the license.
+	
+	
+	## The MIT License ##
+	
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+
+*/
+
+
+#include <stdlib.h>
+
+#include "token.h"
+#include "token_store.h"
+
+#define kTokenStoreStartingSize 256
+
+
+/// Ensure that store can hold the specified number of tokens
+static void token_store_ensure_capacity(token_store * s, size_t capacity) {
+	if (capacity <= s->capacity)
+		return;
+
+	while (s->capacity < capacity)
+		s->capacity *= 2;
+
+	s->type = realloc(s->type, sizeof(unsigned short) * s->capacity);
+	s->flags = realloc(s->flags, sizeof(unsigned char) * s->capacity);
+	s->link = realloc(s->link, sizeof(token *) * s->capacity);
+	s->opener_below = realloc(s->opener_below, sizeof(size_t) * s->capacity);
+	s->pair_depth = realloc(s->pair_depth, sizeof(unsigned short) * s->capacity);
+}
+
+
+/// Create a new token store with an initial capacity
+/// (0 to use default capacity)
+token_store * token_store_new(size_t startingSize) {
+	token_store * s = malloc(sizeof(token_store));
+
+	if (s) {
+		if (startingSize == 0)
+			startingSize = kTokenStoreStartingSize;
+
+		s->size = 0;
+		s->capacity = startingSize;
+
+		s->type = malloc(sizeof(unsigned short) * startingSize);
+		s->flags = malloc(sizeof(unsigned char) * startingSize);
+		s->link = malloc(sizeof(token *) * startingSize);
+		s->opener_below = malloc(sizeof(size_t) * startingSize);
+		s->pair_depth = malloc(sizeof(unsigned short) * startingSize);
+
+		for (int i = 0; i < kMaxTokenTypes; ++i)
+			s->opener_top[i] = kTokenStoreNoIndex;
+
+		for (int i = 0; i < kTokenTypeMaskWords; ++i)
+			s->opener_live[i] = 0;
+	}
+
+	return s;
+}
+
+
+/// Free the token store (the tokens themselves are not affected)
+void token_store_free(token_store * s) {
+	if (s == NULL)
+		return;
+
+	free(s->type);
+	free(s->flags);
+	free(s->link);
+	free(s->opener_below);
+	free(s->pair_depth);
+
+	free(s);
+}
+
+
+/// Append a token chain to the end of the store.  Returns the
+/// index of the first token from the chain.
+size_t token_store_append_chain(token_store * s, token * first) {
+	size_t index = s->size;
+	size_t i = index;
+	unsigned char flags;
+
+	while (first != NULL) {
+		if (i == s->capacity)
+			token_store_ensure_capacity(s, i + 1);
+
+		flags = 0;
+
+		if (first->can_open)
+			flags |= TOKEN_STORE_CAN_OPEN;
+
+		if (first->can_close)
+			flags |= TOKEN_STORE_CAN_CLOSE;
+
+		if (first->unmatched)
+			flags |= TOKEN_STORE_UNMATCHED;
+
+		if (first->child)
+			flags |= TOKEN_STORE_HAS_CHILD;
+
+		s->type[i] = first->type;
+		s->flags[i] = flags;
+		s->link[i] = first;
+
+		i++;
+		first = first->next;
+	}
+
+	s->size = i;
+
+	return index;
+}
+
+
+/// Reduce store to the specified number of tokens
+void token_store_truncate(token_store * s, size_t size) {
+	if (size < s->size)
+		s->size = size;
+}
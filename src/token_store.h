@@ -0,0 +1,141 @@
+/**
+
+	MultiMarkdown 6 -- Lightweight markup processor to produce HTML, LaTeX, and more.
+
+	@file token_store.h
+
+	@brief Dense "struct of arrays" copy of the fields of a token chain that are
+	read in tight loops (e.g. when matching pairs), so that those loops do not
+	need to pull an entire token into cache for each step.
+
+
+	@author	Fletcher T. Penney
+	@bug	
+
+**/
+
+/*
+
+	Copyright © 2016 - 2017 Fletcher T. Penney.
+
+
+	The `MultiMarkdown 6` project is released under the MIT License..
+	
+	GLibFacade.c and GLibFacade.h are from the MultiMarkdown v4 project:
+	
+		https://github.com/fletcher/MultiMarkdown-4/
+	
+	MMD 4 is released under both the MIT License and GPL.
+	
+	
+	CuTest is released under the zlib/libpng license. See CuTest.c for the text
+	of the license.
+	
+	
+	## The MIT License ##
+	
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+	
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+
+*/
+
+
+#ifndef TOKEN_STORE_MULTIMARKDOWN_H
+#define TOKEN_STORE_MULTIMARKDOWN_H
+
+#include "token.h"
+
+
+#define kTokenStoreNoIndex	SIZE_MAX	//!< Marks the end of a list of indices
+
+#define kTokenTypeMaskWords	((kMaxTokenTypes + 63) / 64)	//!< Words needed for one bit per token type
+
+
+/// Flags stored for each token
+enum token_store_flags {
+	TOKEN_STORE_CAN_OPEN	= 1 << 0,		//!< Token can open a pair
+	TOKEN_STORE_CAN_CLOSE	= 1 << 1,		//!< Token can close a pair
+	TOKEN_STORE_UNMATCHED	= 1 << 2,		//!< Token has not been matched yet
+	TOKEN_STORE_HAS_CHILD	= 1 << 3,		//!< Token has a child chain
+};
+
+
+/// Structure for a token store.  Each index refers to one token;
+/// consecutive indices loaded from the same chain are linked by `next`.
+///
+/// While pairing tokens, the openers that are waiting to be matched are
+/// also kept in one list per token type (most recent first), so that a
+/// closer can find its opener without searching through unrelated types.
+struct token_store {
+	size_t				size;			//!< Number of tokens currently in store
+	size_t				capacity;		//!< Total current capacity for store
+
+	unsigned short *	type;			//!< Token types
+	unsigned char *		flags;			//!< Token flags
+	token **			link;			//!< Pointers back to the tokens themselves
+
+	size_t *			opener_below;	//!< Index of the previous waiting opener of the same type
+	unsigned short *	pair_depth;		//!< How deeply pruned pairs matched after each waiting opener are nested
+	size_t				opener_top[kMaxTokenTypes];	//!< Index of the most recent waiting opener of each type
+	uint64_t			opener_live[kTokenTypeMaskWords];	//!< Which types have openers waiting inside the current token?
+};
+
+typedef struct token_store token_store;
+
+
+/// Access fields for token at a given index
+#define token_store_type(s, i)		((s)->type[i])
+#define token_store_flag(s, i, f)	((s)->flags[i] & (f))
+#define token_store_token(s, i)		((s)->link[i])
+
+
+/// Bit masks with one bit per token type
+#define token_type_mask_has(m, t)	((m)[(t) >> 6] & ((uint64_t) 1 << ((t) & 63)))
+#define token_type_mask_set(m, t)	((m)[(t) >> 6] |= ((uint64_t) 1 << ((t) & 63)))
+#define token_type_mask_clear(m, t)	((m)[(t) >> 6] &= ~((uint64_t) 1 << ((t) & 63)))
+
+
+/// Create a new token store with an initial capacity
+/// (0 to use default capacity)
+token_store * token_store_new(
+	size_t startingSize				//!< Default capacity for store
+);
+
+
+/// Free the token store (the tokens themselves are not affected)
+void token_store_free(
+	token_store * s					//!< Store to be freed
+);
+
+
+/// Append a token chain to the end of the store.  Returns the
+/// index of the first token from the chain.
+size_t token_store_append_chain(
+	token_store * s,				//!< Store to use
+	token * first					//!< First token in chain to be added
+);
+
+
+/// Reduce store to the specified number of tokens
+void token_store_truncate(
+	token_store * s,				//!< Store to use
+	size_t size						//!< New size for store
+);
+
+
+#endif
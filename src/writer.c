@@ -63,6 +63,7 @@
 #include "d_string.h"
 #include "html.h"
 #include "mmd.h"
+#include "object_pool.h"
 #include "scanners.h"
 #include "token.h"
 #include "writer.h"
@@ -76,6 +77,45 @@ void store_link(scratch_pad * scratch, link * l);
 
 void store_metadata(scratch_pad * scratch, meta * m);
 
+// Knuth's pseudo random generator is used to obfuscate email addresses (see rng.c)
+void ran_num_restart();
+unsigned long ran_num_position();
+void ran_num_seek(unsigned long position);
+
+
+/// How many of the engine's definitions have been stored in a scratch pad
+typedef struct {
+	int					links;
+	int					footnotes;
+	int					citations;
+	int					metadata;
+} stored_definitions;
+
+
+/// Store definitions that were added to the engine's stacks after the ones
+/// counted in `stored`, in hashes for rapid retrieval when exporting
+static void scratch_pad_store_definitions(scratch_pad * p, mmd_engine * e, stored_definitions * stored) {
+	for (; stored->links < e->link_stack->size; ++stored->links)
+	{
+		store_link(p, stack_peek_index(e->link_stack, stored->links));
+	}
+
+	for (; stored->footnotes < e->footnote_stack->size; ++stored->footnotes)
+	{
+		store_footnote(p, stack_peek_index(e->footnote_stack, stored->footnotes));
+	}
+
+	for (; stored->citations < e->citation_stack->size; ++stored->citations)
+	{
+		store_citation(p, stack_peek_index(e->citation_stack, stored->citations));
+	}
+
+	for (; stored->metadata < e->metadata_stack->size; ++stored->metadata)
+	{
+		store_metadata(p, stack_peek_index(e->metadata_stack, stored->metadata));
+	}
+}
+
 
 /// Temporary storage while exporting parse tree to output format
 scratch_pad * scratch_pad_new(mmd_engine * e) {
@@ -90,18 +130,17 @@ scratch_pad * scratch_pad_new(mmd_engine * e) {
 		p->quotes_lang = e->quotes_lang;
 		p->language = e->language;
 
-		// Store links in a hash for rapid retrieval when exporting
-		p->link_hash = NULL;
-		link * l;
+		p->sink = NULL;
 
-		for (int i = 0; i < e->link_stack->size; ++i)
-		{
-			l = stack_peek_index(e->link_stack, i);
+		p->provisional = false;
+		p->defer_block = false;
+		p->defer_footnotes = false;
+		p->defer_citations = false;
 
-			store_link(p, l);
-		}
+		// Links are stored in a hash for rapid retrieval when exporting
+		p->link_hash = NULL;
 
-		// Store footnotes in a hash for rapid retrieval when exporting
+		// Footnotes
 		p->used_footnotes = stack_new(0);				// Store footnotes as we use them
 		p->inline_footnotes_to_free = stack_new(0);		// Inline footnotes need to be freed
 		p->footnote_being_printed = 0;
@@ -109,39 +148,18 @@ scratch_pad * scratch_pad_new(mmd_engine * e) {
 
 		p->footnote_hash = NULL;				// Store defined footnotes in a hash
 
-		footnote * f;
-
-		for (int i = 0; i < e->footnote_stack->size; ++i)
-		{
-			f = stack_peek_index(e->footnote_stack, i);
-
-			store_footnote(p, f);
-		}
-
-		// Store citations in a hash for rapid retrieval when exporting
+		// Citations
 		p->used_citations = stack_new(0);
 		p->inline_citations_to_free = stack_new(0);
 		p->citation_being_printed = 0;
 
 		p->citation_hash = NULL;
 
-		for (int i = 0; i < e->citation_stack->size; ++i)
-		{
-			f = stack_peek_index(e->citation_stack, i);
-
-			store_citation(p, f);
-		}
-
-		// Store links in a hash for rapid retrieval when exporting
+		// Metadata
 		p->meta_hash = NULL;
-		meta * m;
-
-		for (int i = 0; i < e->metadata_stack->size; ++i)
-		{
-			m = stack_peek_index(e->metadata_stack, i);
 
-			store_metadata(p, m);
-		}
+		stored_definitions stored = { 0, 0, 0, 0 };
+		scratch_pad_store_definitions(p, e, &stored);
 	}
 
 	return p;
@@ -212,6 +230,20 @@ void pad(DString * d, short num, scratch_pad * scratch) {
 }
 
 
+/// Hand output along to the sink, if there is one and enough output is waiting
+void output_sink_check(DString * out, scratch_pad * scratch) {
+	output_sink * sink = scratch->sink;
+
+	if (sink && (out == sink->buffer) && (out->currentStringLength >= sink->threshold) && out->currentStringLength) {
+		sink->write(sink->context, out->str, out->currentStringLength);
+
+		// Keep the buffer for more output
+		out->currentStringLength = 0;
+		out->str[0] = '\0';
+	}
+}
+
+
 void print_token_raw(DString * out, const char * source, token * t) {
 	if (t) {
 		switch (t->type) {
@@ -242,7 +274,12 @@ char * text_inside_pair(const char * source, token * pair) {
 	char * result = NULL;
 
 	if (source && pair) {
-		result = strndup(&source[pair->start + pair->child->len], pair->len - (pair->child->len + 1));
+		if (pair->len > pair->child->len) {
+			result = strndup(&source[pair->start + pair->child->len], pair->len - (pair->child->len + 1));
+		} else {
+			// Nothing inside (e.g. an empty header at the end of the source)
+			result = strdup("");
+		}
 	}
 
 	return result;
@@ -1083,7 +1120,13 @@ void process_metadata_stack(mmd_engine * e, scratch_pad * scratch) {
 }
 
 
-void mmd_export_token_tree(DString * out, mmd_engine * e, short format) {
+/// Export the token tree to `out`, handing output along to `sink` (if not
+/// NULL) as it is rendered
+static void mmd_export_token_tree_with_sink(DString * out, mmd_engine * e, short format, output_sink * sink) {
+#ifdef kUseObjectPool
+	// Tokens created during export belong to the engine's arena
+	pool * previous_pool = token_pool_use(e->token_pool);
+#endif
 
 	// Process potential reference definitions
 	process_definition_stack(e);
@@ -1093,6 +1136,10 @@ void mmd_export_token_tree(DString * out, mmd_engine * e, short format) {
 
 	// Create scratch pad
 	scratch_pad * scratch = scratch_pad_new(e);
+	scratch->sink = sink;
+
+	// Obfuscated email addresses are the same each time a document is exported
+	ran_num_restart();
 
 	// Process metadata
 	process_metadata_stack(e, scratch);
@@ -1113,7 +1160,448 @@ void mmd_export_token_tree(DString * out, mmd_engine * e, short format) {
 			break;
 	}
 
+	if (sink) {
+		// Whatever is left
+		sink->threshold = 0;
+		output_sink_check(out, scratch);
+	}
+
+	scratch_pad_free(scratch);
+
+#ifdef kUseObjectPool
+	token_pool_use(previous_pool);
+#endif
+}
+
+
+void mmd_export_token_tree(DString * out, mmd_engine * e, short format) {
+	mmd_export_token_tree_with_sink(out, e, format, NULL);
+}
+
+
+/// Export the token tree, handing the output to a callback in pieces as it
+/// is rendered
+void mmd_export_token_tree_to_sink(mmd_engine * e, short format, mmd_write_callback write, void * context, size_t flush_threshold) {
+	output_sink sink = { d_string_new(""), write, context, flush_threshold };
+
+	mmd_export_token_tree_with_sink(sink.buffer, e, format, &sink);
+
+	d_string_free(sink.buffer, true);
+}
+
+
+/// Write output to a stdio stream
+static void output_sink_write_file(void * context, const char * buffer, size_t len) {
+	fwrite(buffer, 1, len, (FILE *) context);
+}
+
+
+/// Export the token tree to a stdio stream as it is rendered
+void mmd_export_token_tree_to_file(mmd_engine * e, short format, FILE * stream, size_t flush_threshold) {
+	mmd_export_token_tree_to_sink(e, format, output_sink_write_file, stream, flush_threshold);
+}
+
+
+/// Blocks that were rendered before everything they refer to was defined,
+/// and have to be rendered again at the end of the document
+typedef struct {
+	size_t				start;			//!< Offset of the provisional output
+	size_t				len;			//!< Length of the provisional output
+	token *				first;			//!< First block
+	token *				last;			//!< Last block
+	short				padded;			//!< `scratch->padded` before the blocks
+	unsigned long		random;			//!< Random number position before the blocks
+} fixup;
+
+
+/// Forget that notes after the first `count` were used, so that they are
+/// numbered when the block is rendered again.  Returns true if any were.
+static bool unmark_notes_after(stack * used, int count) {
+	if (used->size <= count)
+		return false;
+
+	while (used->size > count) {
+		footnote * f = stack_pop(used);
+		f->count = -1;
+	}
+
+	return true;
+}
+
+
+/// Parse and export the engine's string a segment at a time (see
+/// `mmd_engine_parse_segment()`), handing the output for each segment to
+/// `progress` as soon as it is rendered.  References to links, footnotes and
+/// citations that aren't defined yet are rendered as placeholders, and the
+/// blocks containing them are rendered again once the whole string has been
+/// parsed.  The finished document, with those blocks replaced, is in `out`.
+void mmd_export_progressive(DString * out, mmd_engine * e, short format, mmd_write_callback progress, void * context) {
+	const char * source = e->dstr->str;
+
+	// Free existing parse tree
+	if (e->root) {
+		token_tree_free(e->root);
+		e->root = NULL;
+	}
+
+#ifdef kUseObjectPool
+	// Tokens created during export belong to the engine's arena
+	pool * previous_pool = token_pool_use(e->token_pool);
+#endif
+
+	token * root = token_new(0, 0, 0);
+	token * doc;
+
+	// Create scratch pad
+	scratch_pad * scratch = scratch_pad_new(e);
+	scratch->provisional = true;
+
+	stored_definitions stored = { e->link_stack->size, e->footnote_stack->size, e->citation_stack->size, e->metadata_stack->size };
+
+	// Obfuscated email addresses are the same each time a document is exported
+	ran_num_restart();
+
+	fixup * fixups = NULL;
+	size_t fixup_count = 0;
+	size_t fixup_capacity = 0;
+
+	size_t offset = 0;
+	size_t emitted = out->currentStringLength;
+	bool first_segment = true;
+	size_t start;
+	short padded;
+	int footnotes;
+	int citations;
+	unsigned long random;
+
+	while ((doc = mmd_engine_parse_segment(e, &offset))) {
+		// Store definitions from this segment
+		process_definition_stack(e);
+		scratch_pad_store_definitions(scratch, e, &stored);
+
+		if (first_segment) {
+			// Metadata can only be in the first segment
+			process_metadata_stack(e, scratch);
+			first_segment = false;
+
+			if ((format == FORMAT_HTML) && (scratch->extensions & EXT_COMPLETE))
+				mmd_start_complete_html(out, source, scratch);
+		}
+
+		start = out->currentStringLength;
+		padded = scratch->padded;
+		footnotes = scratch->used_footnotes->size;
+		citations = scratch->used_citations->size;
+		random = ran_num_position();
+		scratch->defer_block = false;
+
+		switch (format) {
+			case FORMAT_HTML:
+				mmd_export_token_tree_html(out, source, doc->child, 0, scratch);
+				break;
+		}
+
+		if (scratch->defer_block && doc->child) {
+			// Notes used by these blocks are numbered when they are rendered
+			// again, and later notes have to wait for them
+			if (unmark_notes_after(scratch->used_footnotes, footnotes))
+				scratch->defer_footnotes = true;
+
+			if (unmark_notes_after(scratch->used_citations, citations))
+				scratch->defer_citations = true;
+
+			if (fixup_count == fixup_capacity) {
+				fixup_capacity = (fixup_capacity) ? fixup_capacity * 2 : 64;
+				fixups = realloc(fixups, sizeof(fixup) * fixup_capacity);
+			}
+
+			fixups[fixup_count++] = (fixup) {
+				start, out->currentStringLength - start, doc->child, doc->child->tail, padded, random
+			};
+		}
+
+		if (progress && (out->currentStringLength > emitted)) {
+			progress(context, &out->str[emitted], out->currentStringLength - emitted);
+			emitted = out->currentStringLength;
+		}
+
+		// Keep the blocks, which may be rendered again
+		token_append_child(root, doc->child);
+		doc->child = NULL;
+		token_free(doc);
+	}
+
+	// Headers are cross-reference targets, after any link definitions
+	process_header_stack(e);
+	scratch_pad_store_definitions(scratch, e, &stored);
+
+	scratch->provisional = false;
+
+	if (fixup_count) {
+		// Render the deferred blocks again, in order, drawing the same random
+		// numbers as the first time, and then pick up where the pass ended
+		DString * patched = d_string_new("");
+		size_t copied = 0;
+
+		padded = scratch->padded;
+		random = ran_num_position();
+
+		for (size_t i = 0; i < fixup_count; ++i) {
+			d_string_append_c_array(patched, &out->str[copied], fixups[i].start - copied);
+
+			scratch->padded = fixups[i].padded;
+			ran_num_seek(fixups[i].random);
+
+			for (token * t = fixups[i].first; t != NULL; t = t->next) {
+				switch (format) {
+					case FORMAT_HTML:
+						mmd_export_token_html(patched, source, t, 0, scratch);
+						break;
+				}
+
+				if (t == fixups[i].last)
+					break;
+			}
+
+			copied = fixups[i].start + fixups[i].len;
+		}
+
+		d_string_append_c_array(patched, &out->str[copied], out->currentStringLength - copied);
+
+		scratch->padded = padded;
+		ran_num_seek(random);
+
+		// Replace the provisional output
+		DString swap = *out;
+		*out = *patched;
+		*patched = swap;
+
+		d_string_free(patched, true);
+		free(fixups);
+	}
+
+	emitted = out->currentStringLength;
+
+	switch (format) {
+		case FORMAT_HTML:
+			mmd_export_footnote_list_html(out, source, scratch);
+			mmd_export_citation_list_html(out, source, scratch);
+
+			if (scratch->extensions & EXT_COMPLETE)
+				mmd_end_complete_html(out, source, scratch);
+
+			break;
+	}
+
+	if (progress && (out->currentStringLength > emitted))
+		progress(context, &out->str[emitted], out->currentStringLength - emitted);
+
 	scratch_pad_free(scratch);
+
+	e->root = root;
+
+#ifdef kUseObjectPool
+	token_pool_use(previous_pool);
+#endif
+}
+
+
+/// Copy the contents of notes after the first `count`, so that they outlast
+/// the segment they were found in
+static void keep_note_contents(stack * notes, int count) {
+	for (; count < notes->size; ++count) {
+		footnote * f = stack_peek_index(notes, count);
+
+		f->content = token_chain_copy(f->content);
+		f->label = NULL;
+	}
+}
+
+
+/// Free definitions that were added to the engine's stacks after the ones
+/// counted in `kept`
+static void discard_definitions_after(mmd_engine * e, stored_definitions * kept) {
+	while (e->link_stack->size > kept->links)
+		link_free(stack_pop(e->link_stack));
+
+	while (e->footnote_stack->size > kept->footnotes)
+		footnote_free(stack_pop(e->footnote_stack));
+
+	while (e->citation_stack->size > kept->citations)
+		footnote_free(stack_pop(e->citation_stack));
+
+	while (e->metadata_stack->size > kept->metadata)
+		meta_free(stack_pop(e->metadata_stack));
+}
+
+
+/// Export the engine's string in two passes, keeping only one segment (see
+/// `mmd_engine_parse_segment()`) in memory at a time.  The first pass finds
+/// the definitions, headers and metadata, and the second parses and renders
+/// each segment, then frees it.
+static void mmd_export_segments_with_sink(DString * out, mmd_engine * e, short format, output_sink * sink) {
+	const char * source = e->dstr->str;
+
+	// Free existing parse tree
+	if (e->root) {
+		token_tree_free(e->root);
+		e->root = NULL;
+	}
+
+#ifdef kUseObjectPool
+	// Segments are parsed into an arena of their own, which is reset after
+	// each one.  Note contents are copied into the engine's arena.
+	pool * kept_pool = e->token_pool;
+	pool * segment_pool = token_pool_new();
+	pool * previous_pool = token_pool_use(kept_pool);
+
+	e->token_pool = segment_pool;
+#endif
+
+	stored_definitions found = { e->link_stack->size, e->footnote_stack->size, e->citation_stack->size, e->metadata_stack->size };
+	stack * header_links = stack_new(0);
+	size_t offset = 0;
+	token * doc;
+	link * l;
+
+	e->header_stack->size = 0;
+
+	// First pass -- find everything a reference might point to
+	while ((doc = mmd_engine_scan_segment(e, &offset))) {
+		process_definition_stack(e);
+
+		for (int i = found.links; i < e->link_stack->size; ++i) {
+			l = stack_peek_index(e->link_stack, i);
+			l->label = NULL;
+		}
+
+#ifdef kUseObjectPool
+		token_pool_use(kept_pool);
+#endif
+		keep_note_contents(e->footnote_stack, found.footnotes);
+		keep_note_contents(e->citation_stack, found.citations);
+
+		// Headers are cross-reference targets, after any link definitions
+		if (!(e->extensions & EXT_NO_LABELS)) {
+			for (int i = 0; i < e->header_stack->size; ++i) {
+				process_header_to_links(e, stack_peek_index(e->header_stack, i));
+				l = stack_pop(e->link_stack);
+				l->label = NULL;
+				stack_push(header_links, l);
+			}
+		}
+
+		e->header_stack->size = 0;
+
+		found = (stored_definitions) { e->link_stack->size, e->footnote_stack->size, e->citation_stack->size, e->metadata_stack->size };
+
+		token_tree_free(doc);
+
+#ifdef kUseObjectPool
+		pool_reset(segment_pool);
+#endif
+	}
+
+	for (int i = 0; i < header_links->size; ++i)
+		stack_push(e->link_stack, stack_peek_index(header_links, i));
+
+	stack_free(header_links);
+
+	found.links = e->link_stack->size;
+
+	// Create scratch pad
+	scratch_pad * scratch = scratch_pad_new(e);
+	scratch->sink = sink;
+
+	// Obfuscated email addresses are the same each time a document is exported
+	ran_num_restart();
+
+	// Process metadata
+	process_metadata_stack(e, scratch);
+
+	if ((format == FORMAT_HTML) && (scratch->extensions & EXT_COMPLETE))
+		mmd_start_complete_html(out, source, scratch);
+
+	// Second pass -- render each segment, then free it
+	offset = 0;
+	int footnotes;
+	int citations;
+
+	while ((doc = mmd_engine_parse_segment(e, &offset))) {
+		// Definition blocks aren't rendered, and were already stored
+		process_definition_stack(e);
+		discard_definitions_after(e, &found);
+		e->header_stack->size = 0;
+
+		footnotes = scratch->inline_footnotes_to_free->size;
+		citations = scratch->inline_citations_to_free->size;
+
+#ifdef kUseObjectPool
+		token_pool_use(segment_pool);
+#endif
+
+		switch (format) {
+			case FORMAT_HTML:
+				mmd_export_token_tree_html(out, source, doc->child, 0, scratch);
+				break;
+		}
+
+#ifdef kUseObjectPool
+		token_pool_use(kept_pool);
+#endif
+
+		// Inline notes are listed at the end of the document
+		keep_note_contents(scratch->inline_footnotes_to_free, footnotes);
+		keep_note_contents(scratch->inline_citations_to_free, citations);
+
+		token_tree_free(doc);
+
+#ifdef kUseObjectPool
+		pool_reset(segment_pool);
+#endif
+	}
+
+	switch (format) {
+		case FORMAT_HTML:
+			mmd_export_footnote_list_html(out, source, scratch);
+			mmd_export_citation_list_html(out, source, scratch);
+
+			if (scratch->extensions & EXT_COMPLETE)
+				mmd_end_complete_html(out, source, scratch);
+
+			break;
+	}
+
+	if (sink) {
+		// Whatever is left
+		sink->threshold = 0;
+		output_sink_check(out, scratch);
+	}
+
+	scratch_pad_free(scratch);
+
+#ifdef kUseObjectPool
+	e->token_pool = kept_pool;
+	token_pool_release(segment_pool);
+	token_pool_use(previous_pool);
+#endif
+}
+
+
+/// Export the engine's string a segment at a time, handing the output to a
+/// callback in pieces as it is rendered
+void mmd_export_segments_to_sink(mmd_engine * e, short format, mmd_write_callback write, void * context, size_t flush_threshold) {
+	output_sink sink = { d_string_new(""), write, context, flush_threshold };
+
+	mmd_export_segments_with_sink(sink.buffer, e, format, &sink);
+
+	d_string_free(sink.buffer, true);
+}
+
+
+/// Export the engine's string a segment at a time to a stdio stream
+void mmd_export_segments_to_file(mmd_engine * e, short format, FILE * stream, size_t flush_threshold) {
+	mmd_export_segments_to_sink(e, format, output_sink_write_file, stream, flush_threshold);
 }
 
 
@@ -1153,6 +1641,18 @@ void parse_brackets(const char * source, scratch_pad * scratch, token * bracket,
 		}
 	}
 
+	if (scratch->link_hash == NULL) {
+		// No link definitions, so no need to check the text inside the
+		// brackets (which is costly for deeply nested brackets)
+		*final_link = NULL;
+
+		// Unless they are defined later
+		if (scratch->provisional)
+			scratch->defer_block = true;
+
+		return;
+	}
+
 	if (next && next->type == PAIR_BRACKET) {
 		// Is this a reference link? `[foo][bar]` or `![foo][bar]`
 		temp_char = text_inside_pair(source, next);
@@ -1185,8 +1685,11 @@ void parse_brackets(const char * source, scratch_pad * scratch, token * bracket,
 		return;
 	}
 
-	// No existing links, so nothing to do
+	// No existing links, so nothing to do (unless one is defined later)
 	*final_link = NULL;
+
+	if (scratch->provisional)
+		scratch->defer_block = true;
 }
 
 
@@ -1212,59 +1715,48 @@ void mark_footnote_as_used(scratch_pad * scratch, footnote * f) {
 }
 
 
-size_t extract_citation_from_stack(scratch_pad * scratch, const char * target) {
+/// Find a footnote or citation by its label
+static footnote * note_from_hash(fn_holder * hash, const char * target) {
 	char * key = clean_string(target, true);
 
 	fn_holder * h;
 
-	HASH_FIND_STR(scratch->citation_hash, key, h);
+	HASH_FIND_STR(hash, key, h);
 
 	free(key);
 
-	if (h) {
-		mark_citation_as_used(scratch, h->note);
-		return h->note->count;
-	}
+	if (h)
+		return h->note;
 
 	key = label_from_string(target);
 
-	HASH_FIND_STR(scratch->citation_hash, key, h);
+	HASH_FIND_STR(hash, key, h);
 
 	free(key);
 
-	if (h) {
-		mark_citation_as_used(scratch, h->note);
-		return h->note->count;
-	}
-
-	// None found
-	return -1;
+	return (h) ? h->note : NULL;
 }
 
 
-size_t extract_footnote_from_stack(scratch_pad * scratch, const char * target) {
-	char * key = clean_string(target, true);
-
-	fn_holder * h;
-
-	HASH_FIND_STR(scratch->footnote_hash, key, h);
-
-	free(key);
+size_t extract_citation_from_stack(scratch_pad * scratch, const char * target) {
+	footnote * c = note_from_hash(scratch->citation_hash, target);
 
-	if (h) {
-		mark_footnote_as_used(scratch, h->note);
-		return h->note->count;
+	if (c) {
+		mark_citation_as_used(scratch, c);
+		return c->count;
 	}
 
-	key = label_from_string(target);
+	// None found
+	return -1;
+}
 
-	HASH_FIND_STR(scratch->footnote_hash, key, h);
 
-	free(key);
+size_t extract_footnote_from_stack(scratch_pad * scratch, const char * target) {
+	footnote * f = note_from_hash(scratch->footnote_hash, target);
 
-	if (h) {
-		mark_footnote_as_used(scratch, h->note);
-		return h->note->count;
+	if (f) {
+		mark_footnote_as_used(scratch, f);
+		return f->count;
 	}
 
 	// None found
@@ -1331,3 +1823,60 @@ void citation_from_bracket(const char * source, scratch_pad * scratch, token * t
 	}
 }
 
+
+/// Wait for the end of the document if the note isn't defined yet, or an
+/// earlier one is already waiting
+static bool note_is_deferred(const char * source, scratch_pad * scratch, token * t, fn_holder * hash, bool * defer_notes) {
+	if (!scratch->provisional)
+		return false;
+
+	if (!*defer_notes) {
+		char * text = text_inside_pair(source, t);
+		*defer_notes = (note_from_hash(hash, text) == NULL);
+		free(text);
+	}
+
+	if (*defer_notes)
+		scratch->defer_block = true;
+
+	return *defer_notes;
+}
+
+
+bool footnote_is_deferred(const char * source, scratch_pad * scratch, token * t) {
+	return note_is_deferred(source, scratch, t, scratch->footnote_hash, &scratch->defer_footnotes);
+}
+
+
+bool citation_is_deferred(const char * source, scratch_pad * scratch, token * t) {
+	return note_is_deferred(source, scratch, t, scratch->citation_hash, &scratch->defer_citations);
+}
+
+
+
+#ifdef TEST
+void Test_mmd_export_progressive(CuTest* tc) {
+	// The first block is rendered again once its footnote is defined, and the
+	// footnote list comes last
+	const char * source = "Write to <foo@example.com>.[^1]\n\nOr <bar@example.com>.\n\n[^1]: Or <baz@example.com>.\n";
+
+	DString * expected = d_string_new("");
+	DString * progressive = d_string_new("");
+
+	mmd_engine * e = mmd_engine_create_with_string(source, EXT_NOTES);
+	mmd_engine_parse_string(e);
+	mmd_export_token_tree(expected, e, FORMAT_HTML);
+	mmd_engine_free(e, true);
+
+	e = mmd_engine_create_with_string(source, EXT_NOTES);
+	mmd_export_progressive(progressive, e, FORMAT_HTML, NULL, NULL);
+	mmd_engine_free(e, true);
+
+	// Email addresses are obfuscated with the same random numbers
+	CuAssertTrue(tc, strstr(progressive->str, "foo@example.com") == NULL);
+	CuAssertStrEquals(tc, expected->str, progressive->str);
+
+	d_string_free(expected, true);
+	d_string_free(progressive, true);
+}
+#endif
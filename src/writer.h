@@ -67,6 +67,16 @@
 #include "uthash.h"
 
 
+/// Destination for output that is handed along as it is rendered.  Output
+/// collects in `buffer` until at least `threshold` bytes are waiting.
+typedef struct {
+	DString *			buffer;
+	mmd_write_callback	write;
+	void *				context;
+	size_t				threshold;
+} output_sink;
+
+
 typedef struct {
 	struct link *		link_hash;
 	struct meta *		meta_hash;
@@ -89,8 +99,13 @@ typedef struct {
 
 	short				language;
 	short				quotes_lang;
-	
-	char 				_PADDING[4];	//!< pad struct for alignment
+
+	bool				provisional;		//!< Later definitions are not known yet (progressive export)
+	bool				defer_block;		//!< Block has to be rendered again at the end of the document
+	bool				defer_footnotes;	//!< Footnotes are numbered at the end of the document
+	bool				defer_citations;	//!< Citations are numbered at the end of the document
+
+	output_sink *		sink;			//!< Where output is handed along as it is rendered (or NULL)
 
 } scratch_pad;
 
@@ -153,6 +168,9 @@ void scratch_pad_free(scratch_pad * scratch);
 /// Ensure at least num newlines at end of output buffer
 void pad(DString * d, short num, scratch_pad * scratch);
 
+/// Hand output along to the sink, if there is one and enough output is waiting
+void output_sink_check(DString * out, scratch_pad * scratch);
+
 link * explicit_link(scratch_pad * scratch, token * label, token * url, const char * source);
 
 /// Find link based on label
@@ -177,6 +195,13 @@ char * url_accept(const char * source, token ** remainder, bool validate);
 void footnote_from_bracket(const char * source, scratch_pad * scratch, token * t, short * num);
 void citation_from_bracket(const char * source, scratch_pad * scratch, token * t, short * num);
 
+/// When exporting progressively, footnotes and citations are numbered in the
+/// order they are used, so a reference to one that hasn't been defined yet
+/// (and every reference after it) has to wait for the end of the document.
+/// Returns true if this reference waits.
+bool footnote_is_deferred(const char * source, scratch_pad * scratch, token * t);
+bool citation_is_deferred(const char * source, scratch_pad * scratch, token * t);
+
 meta * meta_new(const char * source, size_t start, size_t len);
 void meta_set_value(meta * m, const char * value);
 void meta_free(meta * m);
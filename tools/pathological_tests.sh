@@ -5,100 +5,129 @@ X=65535
 
 Y=$((X-1))
 
+# Print STRING COUNT times, separated by SEP (a newline by default), like
+# `seq -s SEP -f STRING COUNT` on BSD.  GNU seq rejects formats without a
+# % directive, so build the string by doubling instead.
+repeat() {
+	local n=$1 chunk="$2${3-$'\n'}" out=""
+	while [ "$n" -gt 0 ]; do
+		if [ $((n & 1)) -eq 1 ]; then
+			out="$out$chunk"
+		fi
+		chunk="$chunk$chunk"
+		n=$((n >> 1))
+	done
+	printf '%s\n' "${out%"${3-$'\n'}"}"
+}
+
 # Pathological tests from CommonMark
 
 # Nested strong/emph
-seq -f "*a **a" $X >				path1.text
+repeat $X "*a **a" >				path1.text
 echo -n "b " >>						path1.text
-seq -f "a** a*" $X  >>				path1.text
+repeat $X "a** a*"  >>				path1.text
 
 echo -n "<p>" >						path1.html
-seq -f "<em>a <strong>a" $X >>		path1.html
+repeat $X "<em>a <strong>a" >>		path1.html
 echo -n "b " >>						path1.html
-seq -f "a</strong> a</em>" $Y >>	path1.html
+repeat $Y "a</strong> a</em>" >>	path1.html
 echo "a</strong> a</em></p>" >>		path1.html
 
 
 # Close unopened emph
-seq -f "a_" $X >					path2.text
+repeat $X "a_" >					path2.text
 
 echo -n "<p>" >						path2.html
-seq -f "a_" $Y >>					path2.html
+repeat $Y "a_" >>					path2.html
 echo "a_</p>" >>					path2.html
 
 
 # Open unclosed emph
-seq -f "_a" $X >					path3.text
+repeat $X "_a" >					path3.text
 
 echo -n "<p>" >						path3.html
-seq -f "_a" $Y >>					path3.html
+repeat $Y "_a" >>					path3.html
 echo "_a</p>" >>					path3.html
 
 
 # Close unopened links
-seq -f "a]" $X >					path4.text
+repeat $X "a]" >					path4.text
 
 echo -n "<p>" >						path4.html
-seq -f "a]" $Y >>					path4.html
+repeat $Y "a]" >>					path4.html
 echo "a]</p>" >>					path4.html
 
 
 # Open unclosed links
-seq -f "[a" $X >					path5.text
+repeat $X "[a" >					path5.text
 
 echo -n "<p>" >						path5.html
-seq -f "[a" $Y >>					path5.html
+repeat $Y "[a" >>					path5.html
 echo "[a</p>" >>					path5.html
 
 
 # Mismatched * and _
-seq -f "*a_" $X >					path6.text
+repeat $X "*a_" >					path6.text
 
 echo -n "<p>" >						path6.html
-seq -f "*a_" $Y >>					path6.html
+repeat $Y "*a_" >>					path6.html
 echo "*a_</p>" >>					path6.html
 
 
 # Unclosed links and unopened emph
-seq -f "[ a_" $X >					path7.text
+repeat $X "[ a_" >					path7.text
 
 echo -n "<p>" >						path7.html
-seq -f "[ a_" $Y >>					path7.html
+repeat $Y "[ a_" >>					path7.html
 echo "[ a_</p>" >>					path7.html
 
 
 # Complex case
-seq -f "**x [*b**c*](d)" $X >				path8.text
+repeat $X "**x [*b**c*](d)" >				path8.text
 
 echo -n "<p>" >								path8.html
-seq -f "**x <a href=\"d\">*b**c*</a>" $Y >>	path8.html
+repeat $Y "**x <a href=\"d\">*b**c*</a>" >>	path8.html
 echo "**x <a href=\"d\">*b**c*</a></p>" >>	path8.html
 
 
 # Nested brackets
-# TODO: Performance hit between 1000 and 10,000 iterations
-# Checking each level to see if it's a valid link on the stack
-# seq -s " " -f "[" $X >				path9.text
-# echo -n "a" >> 						path9.text
-# seq -s " " -f "]" $X >>				path9.text
-# 
-# echo -n "<p>" >						path9.html
-# seq -s " " -f "[" $X >>				path9.html
-# echo -n "a" >> 						path9.html
-# seq -s " " -f "]" $Y >>				path9.html
-# echo "]</p>" >>						path9.html
+repeat $X "[" " " >				path9.text
+echo -n "a" >> 						path9.text
+repeat $X "]" " " >>				path9.text
+
+echo -n "<p>" >						path9.html
+repeat $X "[" " " >>				path9.html
+echo -n "a" >> 						path9.html
+echo "$(repeat $X "]" " ")</p>" >>	path9.html
 
 
 # Nested block quotes
 # Because MMD-6 handles blockquotes recursively,
-# we hit stack overflow problems at depths over
-# ~ 10k, depending on stack size.
-#
-# seq -s " " -f ">" $X >				path10.text
-# echo -n "a" >> 						path10.text
-# 
-# seq -f "<blockquote>" $X >			path10.html
-# echo "<p>a</p>" >>					path10.html
-# seq -f "</blockquote>" $X >>		path10.html
-
-
+# nesting is limited to kMaxParseDepth (1000) levels.
+# Anything deeper is left as paragraph text.
+
+Z=1000
+
+repeat $X ">" " " >				path10.text
+echo -n "a" >> 						path10.text
+
+repeat $Z "<blockquote>" >			path10.html
+echo -n "<p>" >>					path10.html
+repeat $((X-Z)) "&gt;" " " >>	path10.html
+echo "a</p>" >>						path10.html
+repeat $Z "</blockquote>" >>		path10.html
+
+
+# Time each test, and compare to the expected output, if given
+# the path to a multimarkdown binary (and any flags to pass it)
+if [ -n "$1" ]; then
+	status=0
+	for t in path*.text; do
+		echo "${t%.text}"
+		if ! time "$@" "$t" | cmp -s - "${t%.text}.html"; then
+			echo "  FAILED"
+			status=1
+		fi
+	done
+	exit $status
+fi